@@ -0,0 +1,34 @@
+# Prints the biggest RAM users after every firmware link.
+# Enabled through extra_scripts in platformio.ini.
+
+import subprocess
+
+Import("env")
+
+TOP_SYMBOLS = 25
+
+
+def ram_report(source, target, env):
+    elf = str(target[0])
+    nm = env.subst("$CC").replace("gcc", "nm")
+    output = subprocess.check_output(
+        [nm, "--print-size", "--size-sort", "--reverse-sort", "--demangle", elf],
+        env=env["ENV"],
+        universal_newlines=True,
+    )
+
+    symbols = []
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        # address, size, type, name; b/B is .bss and d/D is .data
+        if len(fields) == 4 and fields[2] in "bBdD":
+            symbols.append((int(fields[1], 16), fields[2], fields[3]))
+
+    total = sum(size for size, _, _ in symbols)
+    print("RAM by symbol (%d bytes in .data and .bss):" % total)
+    for size, kind, name in symbols[:TOP_SYMBOLS]:
+        section = ".bss" if kind in "bB" else ".data"
+        print("%8d  %-5s  %s" % (size, section, name))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", ram_report)
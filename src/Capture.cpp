@@ -0,0 +1,449 @@
+#include "Capture.h"
+#include "Session.h"
+
+#define RECORD_KEY 1
+#define RECORD_MIDI 2
+#define RECORD_OUTPUT 3
+#define MAX_RECORD_LENGTH 10 // tag, 5 byte delta, 4 byte payload
+
+Capture::Capture()
+{
+  dropped = 0;
+  mismatches = 0;
+  missing = 0;
+  _region = NULL;
+  _state = IDLE;
+  _stream_base = 0;
+  _stream_length = 0;
+  _position = 0;
+  _crc = 0;
+  _page = 0;
+  _pending = -1;
+  _fill = 0;
+  _written = 0;
+  _erased = 0;
+  _has_next = false;
+}
+
+void Capture::begin(FlashRegion *region, void *patterns, uint32_t length, void (*save_state)(CaptureState *))
+{
+  _region = region;
+  _patterns = (uint8_t *)patterns;
+  _length = length;
+  _save_state = save_state;
+  _stream_base = Session::slot_size(length);
+}
+
+bool Capture::is_recording()
+{
+  return _state == RECORDING;
+}
+
+bool Capture::is_replaying()
+{
+  return _state == REPLAYING;
+}
+
+// Starts writing the starting pattern storage, see update(). The inputs
+// are logged from the moment it is on flash.
+bool Capture::start_recording()
+{
+  if (_region == NULL || !_region->is_ready || _state != IDLE)
+  {
+    return false;
+  }
+  _position = 0;
+  _state = ERASING;
+  return true;
+}
+
+void Capture::start_logging()
+{
+  memset(&_header, 0, sizeof(CaptureHeader));
+  _header.magic = CAPTURE_MAGIC;
+  _header.version = CAPTURE_VERSION;
+  _header.length = _length;
+  _header.crc = _crc;
+  _save_state(&_header.state);
+
+  dropped = 0;
+  _page = 0;
+  _pending = -1;
+  _fill = 0;
+  _written = 0;
+  _erased = 0;
+  _start_time = micros();
+  _last_time = _start_time;
+  _state = RECORDING;
+  Serial.println("capturing");
+}
+
+void Capture::put(uint8_t byte)
+{
+  _pages[_page][_fill++] = byte;
+  if (_fill == FLASH_PAGE_SIZE)
+  {
+    _pending = _page;
+    _page ^= 1;
+    _fill = 0;
+  }
+}
+
+void Capture::record(uint8_t type, const uint8_t *payload, int length)
+{
+  uint32_t space = (FLASH_PAGE_SIZE - _fill) + (_pending < 0 ? FLASH_PAGE_SIZE : 0);
+  uint32_t capacity = _region->size - _stream_base;
+  if (space < MAX_RECORD_LENGTH || _written + 2 * FLASH_PAGE_SIZE > capacity)
+  {
+    // flash fell behind or is full, the next record's delta covers the gap
+    dropped++;
+    return;
+  }
+
+  unsigned long now = micros();
+  uint32_t delta = now - _last_time;
+  _last_time = now;
+
+  put(type);
+  while (delta >= 0x80)
+  {
+    put((delta & 0x7F) | 0x80);
+    delta >>= 7;
+  }
+  put(delta);
+  for (int i = 0; i < length; i++)
+  {
+    put(payload[i]);
+  }
+}
+
+void Capture::log_key(keypadEvent e)
+{
+  if (_state != RECORDING)
+  {
+    return;
+  }
+  uint8_t payload[2] = {(uint8_t)(e.bit.KEY | (e.bit.EVENT << 5)), (uint8_t)((e.bit.ROW << 4) | e.bit.COL)};
+  record(RECORD_KEY, payload, 2);
+}
+
+void Capture::log_midi(midiEventPacket_t packet)
+{
+  if (_state != RECORDING || packet.header == 0)
+  {
+    return;
+  }
+  uint8_t payload[4] = {packet.header, packet.byte1, packet.byte2, packet.byte3};
+  record(RECORD_MIDI, payload, 4);
+}
+
+void Capture::output(uint8_t status, uint8_t data1, uint8_t data2)
+{
+  if (_state == RECORDING)
+  {
+    uint8_t payload[3] = {status, data1, data2};
+    record(RECORD_OUTPUT, payload, 3);
+  }
+  else if (_state == REPLAYING)
+  {
+    if (!_has_next || _next_type != RECORD_OUTPUT)
+    {
+      mismatches++;
+      return;
+    }
+    if (_next_payload[0] != status || _next_payload[1] != data1 || _next_payload[2] != data2)
+    {
+      mismatches++;
+    }
+    int32_t drift = (int32_t)(micros() - _start_time - _next_time);
+    if (abs(drift) > _max_drift)
+    {
+      _max_drift = abs(drift);
+    }
+    _total_drift += drift;
+    _outputs++;
+    load_next();
+  }
+}
+
+void Capture::flush_page(int page, uint32_t length)
+{
+  while (_written + FLASH_PAGE_SIZE > _erased)
+  {
+    while (_region->is_busy())
+    {
+    }
+    _region->start_erase(_stream_base + _erased);
+    _erased += FLASH_SECTOR_SIZE;
+  }
+  while (_region->is_busy())
+  {
+  }
+  _region->write(_stream_base + _written, _pages[page], length);
+  _written += length;
+}
+
+void Capture::stop()
+{
+  if (_state == REPLAYING)
+  {
+    finish_replay();
+    return;
+  }
+  if (_state == ERASING || _state == WRITING)
+  {
+    _state = IDLE;
+    Serial.println("capture cancelled");
+    return;
+  }
+  if (_state != RECORDING)
+  {
+    return;
+  }
+
+  if (_pending >= 0)
+  {
+    flush_page(_pending, FLASH_PAGE_SIZE);
+  }
+  if (_fill > 0)
+  {
+    flush_page(_page, _fill);
+  }
+
+  _header.stream_length = _written;
+  _header.dropped = dropped;
+  _region->write_header(0, &_header, sizeof(CaptureHeader));
+  _state = IDLE;
+
+  Serial.print("captured ");
+  Serial.print(_written);
+  Serial.print(" bytes, dropped ");
+  Serial.println(dropped);
+}
+
+// Erases and writes the starting pattern storage, then keeps the stream
+// erased ahead of the write position and programs a full page once one is
+// waiting, at most one flash operation per call.
+void Capture::update()
+{
+  if (_state == REPLAYING)
+  {
+    // an output the firmware never produced would stall the replay
+    if (_has_next && _next_type == RECORD_OUTPUT && (int32_t)(micros() - _start_time - _next_time) > REPLAY_TIMEOUT)
+    {
+      missing++;
+      load_next();
+    }
+    if (!_has_next)
+    {
+      finish_replay();
+    }
+    return;
+  }
+  if (_state == IDLE || _region->is_busy())
+  {
+    return;
+  }
+
+  if (_state == ERASING)
+  {
+    if (_position < _stream_base)
+    {
+      _region->start_erase(_position);
+      _position += FLASH_SECTOR_SIZE;
+    }
+    else
+    {
+      _position = 0;
+      _crc = 0;
+      _state = WRITING;
+    }
+    return;
+  }
+  if (_state == WRITING)
+  {
+    if (_position < _length)
+    {
+      uint32_t length = min((uint32_t)FLASH_PAGE_SIZE, _length - _position);
+      _region->write(FLASH_PAGE_SIZE + _position, _patterns + _position, length);
+      _crc = crc32(_crc, _patterns + _position, length);
+      _position += length;
+    }
+    else if (crc32(0, _patterns, _length) != _crc)
+    {
+      // edited behind the write position, the flash copy is stale
+      _position = 0;
+      _state = ERASING;
+    }
+    else
+    {
+      start_logging();
+    }
+    return;
+  }
+
+  uint32_t capacity = _region->size - _stream_base;
+  if (_pending >= 0 && _written + FLASH_PAGE_SIZE <= _erased)
+  {
+    _region->write(_stream_base + _written, _pages[_pending], FLASH_PAGE_SIZE);
+    _written += FLASH_PAGE_SIZE;
+    _pending = -1;
+  }
+  else if (_erased - _written < 2 * FLASH_SECTOR_SIZE && _erased < capacity)
+  {
+    _region->start_erase(_stream_base + _erased);
+    _erased += FLASH_SECTOR_SIZE;
+  }
+}
+
+bool Capture::read_header(CaptureHeader *header)
+{
+  return _region->read_header(0, header, sizeof(CaptureHeader), CAPTURE_MAGIC, CAPTURE_VERSION) &&
+         header->length == _length;
+}
+
+// Loads the pattern storage as it was when the capture started and hands
+// back the rest of the starting state for the caller to apply, see
+// FlashRegion::read_checked() for what is left behind on failure.
+bool Capture::start_replay(CaptureState *state)
+{
+  if (_region == NULL || !_region->is_ready || _state != IDLE || !read_header(&_header) ||
+      !_region->read_checked(FLASH_PAGE_SIZE, _patterns, _length, _header.crc))
+  {
+    return false;
+  }
+  *state = _header.state;
+
+  mismatches = 0;
+  missing = 0;
+  _outputs = 0;
+  _max_drift = 0;
+  _total_drift = 0;
+  _stream_length = _header.stream_length;
+  _read_position = 0;
+  _cache_base = UINT32_MAX;
+  _next_time = 0;
+  _state = REPLAYING;
+  load_next();
+  _start_time = micros();
+  return true;
+}
+
+uint8_t Capture::get()
+{
+  uint32_t base = _read_position & ~(FLASH_PAGE_SIZE - 1);
+  if (base != _cache_base)
+  {
+    _region->read(_stream_base + base, _pages[0], FLASH_PAGE_SIZE);
+    _cache_base = base;
+  }
+  return _pages[0][_read_position++ - base];
+}
+
+void Capture::load_next()
+{
+  if (_read_position >= _stream_length)
+  {
+    _has_next = false;
+    return;
+  }
+  _next_type = get();
+  uint32_t delta = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t byte = get();
+    delta |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+    {
+      break;
+    }
+  }
+  _next_time += delta;
+  int length = _next_type == RECORD_KEY ? 2 : _next_type == RECORD_MIDI ? 4 : 3;
+  for (int i = 0; i < length; i++)
+  {
+    _next_payload[i] = get();
+  }
+  _has_next = true;
+}
+
+bool Capture::is_due(uint8_t type)
+{
+  return _state == REPLAYING && _has_next && _next_type == type && micros() - _start_time >= _next_time;
+}
+
+bool Capture::next_key(keypadEvent *e)
+{
+  if (!is_due(RECORD_KEY))
+  {
+    return false;
+  }
+  e->reg = 0;
+  e->bit.KEY = _next_payload[0] & 0x1F;
+  e->bit.EVENT = _next_payload[0] >> 5;
+  e->bit.ROW = _next_payload[1] >> 4;
+  e->bit.COL = _next_payload[1] & 0x0F;
+  load_next();
+  return true;
+}
+
+bool Capture::next_midi(midiEventPacket_t *packet)
+{
+  if (!is_due(RECORD_MIDI))
+  {
+    packet->header = 0;
+    return false;
+  }
+  packet->header = _next_payload[0];
+  packet->byte1 = _next_payload[1];
+  packet->byte2 = _next_payload[2];
+  packet->byte3 = _next_payload[3];
+  load_next();
+  return true;
+}
+
+void Capture::finish_replay()
+{
+  _state = IDLE;
+  Serial.print("replay ");
+  Serial.println(mismatches == 0 && missing == 0 ? "matches" : "differs");
+  Serial.print("outputs: ");
+  Serial.println(_outputs);
+  Serial.print("mismatched: ");
+  Serial.println(mismatches);
+  Serial.print("missing: ");
+  Serial.println(missing);
+  Serial.print("max drift us: ");
+  Serial.println(_max_drift);
+  Serial.print("mean drift us: ");
+  Serial.println(_outputs > 0 ? (int32_t)(_total_drift / (int64_t)_outputs) : 0);
+}
+
+// Prints the capture as hex so it can be pulled off the device over Serial.
+void Capture::dump()
+{
+  CaptureHeader header;
+  if (_region == NULL || !_region->is_ready || _state != IDLE || !read_header(&header))
+  {
+    Serial.println("no capture");
+    return;
+  }
+  uint32_t length = _stream_base + header.stream_length;
+  for (uint32_t offset = 0; offset < length; offset += FLASH_PAGE_SIZE)
+  {
+    uint32_t count = min((uint32_t)FLASH_PAGE_SIZE, length - offset);
+    _region->read(offset, _pages[0], count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      if (_pages[0][i] < 0x10)
+      {
+        Serial.print("0");
+      }
+      Serial.print(_pages[0][i], HEX);
+      if (i % 32 == 31 || i == count - 1)
+      {
+        Serial.println();
+      }
+    }
+  }
+}
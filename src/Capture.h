@@ -0,0 +1,132 @@
+#ifndef Capture_h
+#define Capture_h
+
+#include "Arduino.h"
+#include <Adafruit_NeoTrellisM4.h>
+#include <MIDIUSB.h>
+#include "FlashRegion.h"
+
+#define CAPTURE_MAGIC 0x43415054 // "CAPT"
+#define CAPTURE_VERSION 2
+#define CAPTURE_FLASH_SIZE (1024 * 1024UL)
+#define REPLAY_TIMEOUT 50000 // us an expected output may be late before it counts as missing
+
+// Everything outside the pattern storage that decides how an input is
+// handled, taken when a capture starts and put back before it is replayed.
+struct CaptureState
+{
+  uint32_t tick;
+  int32_t row_offset;
+  int32_t last_step;
+  int32_t swing;
+  uint32_t pressed_keys; // one bit per key
+  uint32_t key_press_age; // ms since the last key press
+  uint16_t repeat_held;
+  uint8_t repeat_rate;
+  uint8_t repeat_order;
+  uint8_t main_mode;
+  uint8_t manual_note_play_mode;
+  uint8_t manual_note_record_mode;
+  uint8_t manual_cc_mode;
+  uint8_t combo_pressed;
+  uint8_t is_stopped;
+  uint8_t is_upbeat;
+  uint8_t reserved;
+};
+
+struct CaptureHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t length;
+  uint32_t crc;
+  uint32_t stream_length;
+  uint32_t dropped;
+  CaptureState state;
+  uint32_t header_crc;
+};
+
+// Records every keypad event, incoming MIDI packet and outgoing MIDI message
+// with its micros() delta, and replays the inputs in the recorded time while
+// checking the outputs against the recording.
+//
+// Undo history is not part of the state, so an undo past the start of the
+// capture is not reproduced. The pattern storage is written in the
+// background first and logging starts once it is on flash.
+//
+// Flash layout: header page, pattern storage at the start of the capture,
+// then from the next sector on a stream of records:
+//
+//   tag byte (record type), LEB128 delta in us, payload
+//   key:    key | event << 5, row << 4 | col
+//   midi:   header, byte1, byte2, byte3
+//   output: status, data1, data2
+class Capture
+{
+  public:
+    Capture();
+    uint32_t dropped;
+    uint32_t mismatches;
+    uint32_t missing;
+    void begin(FlashRegion *region, void *patterns, uint32_t length, void (*save_state)(CaptureState *));
+    bool start_recording();
+    bool start_replay(CaptureState *state);
+    void stop();
+    bool is_recording();
+    bool is_replaying();
+    void log_key(keypadEvent e);
+    void log_midi(midiEventPacket_t packet);
+    bool next_key(keypadEvent *e);
+    bool next_midi(midiEventPacket_t *packet);
+    void output(uint8_t status, uint8_t data1, uint8_t data2);
+    void update();
+    void dump();
+
+  private:
+    enum State
+    {
+      IDLE,
+      ERASING,
+      WRITING,
+      RECORDING,
+      REPLAYING
+    };
+    FlashRegion *_region;
+    uint8_t *_patterns;
+    uint32_t _length;
+    void (*_save_state)(CaptureState *);
+    State _state;
+    CaptureHeader _header;
+    uint32_t _stream_base;
+    uint32_t _stream_length;
+    uint32_t _position;
+    uint32_t _crc;
+    uint8_t _pages[2][FLASH_PAGE_SIZE];
+    int _page;
+    int _pending;
+    uint32_t _fill;
+    uint32_t _written;
+    uint32_t _erased;
+    unsigned long _start_time;
+    unsigned long _last_time;
+    uint32_t _read_position;
+    uint32_t _cache_base;
+    bool _has_next;
+    uint8_t _next_type;
+    uint32_t _next_time;
+    uint8_t _next_payload[4];
+    uint32_t _outputs;
+    int32_t _max_drift;
+    int64_t _total_drift;
+    void record(uint8_t type, const uint8_t *payload, int length);
+    void put(uint8_t byte);
+    void flush_page(int page, uint32_t length);
+    void start_logging();
+    bool read_header(CaptureHeader *header);
+    uint8_t get();
+    void load_next();
+    bool is_due(uint8_t type);
+    void finish_replay();
+};
+
+#endif
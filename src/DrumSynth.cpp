@@ -0,0 +1,183 @@
+#include "DrumSynth.h"
+#include <math.h>
+
+#define SILENT_AMPLITUDE (1 << 20)
+
+struct DrumModelSettings
+{
+  float tone;
+  float noise;
+  float highpass;
+  float sweep; // start pitch as a multiple of the base pitch
+  float sweep_time; // ms
+};
+
+static const DrumModelSettings drum_models[] = {
+    {1.0, 0.0, 0.0, 3.0, 25},  // DRUM_KICK
+    {0.9, 0.1, 0.05, 1.6, 40}, // DRUM_TOM
+    {0.5, 0.6, 0.15, 1.3, 15}, // DRUM_SNARE
+    {0.0, 0.9, 0.75, 1.0, 1},  // DRUM_HAT
+};
+
+struct DrumSound
+{
+  DrumModel model;
+  float pitch; // Hz
+  float decay; // ms
+  float send;
+};
+
+// General MIDI drum map from FIRST_MIDI_NOTE (36) up
+static const DrumSound drum_kit[DRUM_VOICES] = {
+    {DRUM_KICK, 50, 150, 0.0},   // bass drum
+    {DRUM_SNARE, 420, 40, 0.1},  // side stick
+    {DRUM_SNARE, 185, 120, 0.3}, // snare
+    {DRUM_SNARE, 900, 100, 0.4}, // clap
+    {DRUM_SNARE, 220, 110, 0.3}, // electric snare
+    {DRUM_TOM, 80, 220, 0.15},   // low floor tom
+    {DRUM_HAT, 0, 50, 0.1},      // closed hat
+    {DRUM_TOM, 100, 210, 0.15},  // high floor tom
+    {DRUM_HAT, 0, 80, 0.1},      // pedal hat
+    {DRUM_TOM, 120, 200, 0.2},   // low tom
+    {DRUM_HAT, 0, 250, 0.25},    // open hat
+    {DRUM_TOM, 140, 190, 0.2},   // low mid tom
+    {DRUM_TOM, 165, 180, 0.2},   // high mid tom
+    {DRUM_HAT, 0, 800, 0.4},     // crash
+    {DRUM_TOM, 190, 170, 0.2},   // high tom
+    {DRUM_HAT, 0, 600, 0.3},     // ride
+};
+
+static uint32_t hertzToIncrement(float hertz)
+{
+  return (uint32_t)(hertz / AUDIO_SAMPLE_RATE_EXACT * 4294967296.0);
+}
+
+// per block factor for an exponential fall with the given time constant
+static int32_t blockDecay(float milliseconds)
+{
+  return (int32_t)(expf(-AUDIO_BLOCK_SAMPLES * 1000.0f / (AUDIO_SAMPLE_RATE_EXACT * milliseconds)) * 2147483647.0f);
+}
+
+static int16_t toQ15(float value)
+{
+  return (int16_t)(value * 32767.0f);
+}
+
+DrumSynth::DrumSynth()
+{
+  _random = 0x2545F491;
+
+  for (int i = 0; i <= SINE_TABLE_SIZE; i++)
+  {
+    _sine[i] = toQ15(sinf(2.0f * (float)M_PI * i / SINE_TABLE_SIZE));
+  }
+
+  for (int i = 0; i < DRUM_VOICES; i++)
+  {
+    const DrumSound &sound = drum_kit[i];
+    const DrumModelSettings &model = drum_models[sound.model];
+    DrumVoice &voice = _voices[i];
+    voice.base_increment = hertzToIncrement(sound.pitch);
+    voice.start_increment = hertzToIncrement(sound.pitch * model.sweep);
+    voice.block_decay = blockDecay(sound.decay);
+    voice.sweep_decay = blockDecay(model.sweep_time);
+    voice.tone = toQ15(model.tone);
+    voice.noise = toQ15(model.noise);
+    voice.highpass = toQ15(model.highpass);
+    voice.send = toQ15(sound.send);
+    voice.phase = 0;
+    voice.increment = voice.base_increment;
+    voice.amplitude = 0;
+    voice.lowpass = 0;
+    _pending[i] = 0;
+  }
+}
+
+// Called from loop(), the voice is started by the next render().
+void DrumSynth::trigger(int voice, uint8_t velocity)
+{
+  if (voice >= 0 && voice < DRUM_VOICES && velocity > 0)
+  {
+    _pending[voice] = velocity;
+  }
+}
+
+void DrumSynth::set_send(int voice, uint8_t level)
+{
+  if (voice >= 0 && voice < DRUM_VOICES)
+  {
+    _voices[voice].send = level * 32767 / 127;
+  }
+}
+
+void DrumSynth::render_voice(DrumVoice &voice, int32_t *dry, int32_t *send)
+{
+  int32_t next_amplitude = multiply_q31(voice.amplitude, voice.block_decay);
+  int32_t amplitude_step = (next_amplitude - voice.amplitude) / AUDIO_BLOCK_SAMPLES;
+  int32_t excess = voice.increment - voice.base_increment;
+  int32_t next_excess = multiply_q31(excess, voice.sweep_decay);
+  int32_t increment_step = (next_excess - excess) / AUDIO_BLOCK_SAMPLES;
+
+  uint32_t phase = voice.phase;
+  uint32_t increment = voice.increment;
+  int32_t amplitude = voice.amplitude;
+  int32_t lowpass = voice.lowpass;
+  uint32_t random = _random;
+
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+  {
+    phase += increment;
+    increment += increment_step;
+    uint32_t index = phase >> 24;
+    int32_t fraction = (phase >> 8) & 0xFFFF;
+    int32_t sine = _sine[index] + (((_sine[index + 1] - _sine[index]) * fraction) >> 16);
+
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    int32_t noise = (int16_t)(random >> 16);
+    lowpass += ((noise - lowpass) * voice.highpass) >> 15;
+
+    int32_t x = (sine * voice.tone + (noise - lowpass) * voice.noise) >> 15;
+    int32_t out = (x * (amplitude >> 16)) >> 16; // -6 dB of headroom per voice
+    amplitude += amplitude_step;
+
+    dry[i] += out;
+    send[i] += (out * voice.send) >> 15;
+  }
+
+  voice.phase = phase;
+  voice.increment = voice.base_increment + next_excess;
+  voice.amplitude = next_amplitude;
+  voice.lowpass = lowpass;
+  _random = random;
+}
+
+// Starts the pending voices and mixes one block of every sounding one into
+// dry and send. Returns false when nothing is sounding.
+bool DrumSynth::render(int32_t *dry, int32_t *send)
+{
+  bool is_silent = true;
+
+  memset(dry, 0, AUDIO_BLOCK_SAMPLES * sizeof(int32_t));
+  memset(send, 0, AUDIO_BLOCK_SAMPLES * sizeof(int32_t));
+  for (int i = 0; i < DRUM_VOICES; i++)
+  {
+    DrumVoice &voice = _voices[i];
+    uint8_t velocity = _pending[i];
+    if (velocity > 0)
+    {
+      _pending[i] = 0;
+      voice.phase = 0;
+      voice.increment = voice.start_increment;
+      voice.amplitude = velocity * (INT32_MAX / 127);
+      voice.lowpass = 0;
+    }
+    if (voice.amplitude > SILENT_AMPLITUDE)
+    {
+      render_voice(voice, dry, send);
+      is_silent = false;
+    }
+  }
+  return !is_silent;
+}
@@ -0,0 +1,59 @@
+#ifndef DrumSynth_h
+#define DrumSynth_h
+
+#include "Arduino.h"
+#include <AudioStream.h>
+#include "Dsp.h"
+
+#define DRUM_VOICES 16
+#define SINE_TABLE_SIZE 256
+
+enum DrumModel
+{
+  DRUM_KICK,
+  DRUM_TOM,
+  DRUM_SNARE,
+  DRUM_HAT
+};
+
+struct DrumVoice
+{
+  // set once from the kit
+  uint32_t base_increment; // Q32 fraction of a cycle per sample
+  uint32_t start_increment;
+  int32_t block_decay; // Q31 amplitude factor per block
+  int32_t sweep_decay; // Q31 pitch sweep factor per block
+  int16_t tone;        // Q15 levels
+  int16_t noise;
+  int16_t highpass;
+  int16_t send;
+  // running state
+  uint32_t phase;
+  uint32_t increment;
+  int32_t amplitude; // Q31
+  int32_t lowpass;
+};
+
+// One synthesized drum per grid row: a swept sine plus filtered noise under
+// an exponential envelope, so kick, tom, snare and hat only differ in their
+// levels and rates. Envelopes and sweeps are stepped once per block and
+// ramped linearly across it, leaving the sample loop free of branches.
+//
+// Only the block kernel, DrumVoices feeds it to the audio library.
+class DrumSynth
+{
+  public:
+    DrumSynth();
+    void trigger(int voice, uint8_t velocity);
+    void set_send(int voice, uint8_t level);
+    bool render(int32_t *dry, int32_t *send);
+
+  private:
+    DrumVoice _voices[DRUM_VOICES];
+    volatile uint8_t _pending[DRUM_VOICES];
+    int16_t _sine[SINE_TABLE_SIZE + 1];
+    uint32_t _random;
+    void render_voice(DrumVoice &voice, int32_t *dry, int32_t *send);
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "DrumVoices.h"
+
+DrumVoices::DrumVoices() : AudioStream(0, NULL)
+{
+  cycles = 0;
+  max_cycles = 0;
+}
+
+void DrumVoices::trigger(int voice, uint8_t velocity)
+{
+  _synth.trigger(voice, velocity);
+}
+
+void DrumVoices::set_send(int voice, uint8_t level)
+{
+  _synth.set_send(voice, level);
+}
+
+void DrumVoices::update(void)
+{
+  uint32_t start = cycle_count();
+  int32_t dry[AUDIO_BLOCK_SAMPLES];
+  int32_t send[AUDIO_BLOCK_SAMPLES];
+
+  // no block reads as silence downstream
+  if (_synth.render(dry, send))
+  {
+    audio_block_t *dry_block = allocate();
+    audio_block_t *send_block = allocate();
+    if (dry_block && send_block)
+    {
+      uint32_t *dry_words = (uint32_t *)dry_block->data;
+      uint32_t *send_words = (uint32_t *)send_block->data;
+      for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++)
+      {
+        dry_words[i] = pack16(saturate16(dry[2 * i]), saturate16(dry[2 * i + 1]));
+        send_words[i] = pack16(saturate16(send[2 * i]), saturate16(send[2 * i + 1]));
+      }
+      transmit(dry_block, 0);
+      transmit(send_block, 1);
+    }
+    if (dry_block)
+    {
+      release(dry_block);
+    }
+    if (send_block)
+    {
+      release(send_block);
+    }
+  }
+
+  cycles = cycle_count() - start;
+  if (cycles > max_cycles)
+  {
+    max_cycles = cycles;
+  }
+}
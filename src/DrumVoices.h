@@ -0,0 +1,24 @@
+#ifndef DrumVoices_h
+#define DrumVoices_h
+
+#include "Arduino.h"
+#include <Audio.h>
+#include "DrumSynth.h"
+
+// DrumSynth as an audio library stream. Output 0 is the dry mix, output 1
+// the per-row send for the master chain.
+class DrumVoices : public AudioStream
+{
+  public:
+    DrumVoices();
+    uint32_t cycles;
+    uint32_t max_cycles;
+    void trigger(int voice, uint8_t velocity);
+    void set_send(int voice, uint8_t level);
+    virtual void update(void);
+
+  private:
+    DrumSynth _synth;
+};
+
+#endif
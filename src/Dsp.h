@@ -0,0 +1,87 @@
+#ifndef Dsp_h
+#define Dsp_h
+
+#include "Arduino.h"
+
+// Fixed point helpers for the audio blocks. On the Cortex-M4 they map to
+// single DSP instructions; elsewhere they fall back to plain C, which is
+// what the host tests and the offline render in test/ run on.
+
+#if defined(__ARM_FEATURE_DSP)
+
+static inline int32_t saturate16(int32_t x)
+{
+  return __SSAT(x, 16);
+}
+
+// two Q15 samples into one word, first sample in the low half
+static inline uint32_t pack16(int32_t low, int32_t high)
+{
+  return __PKHBT(low, high, 16);
+}
+
+static inline uint32_t add16(uint32_t a, uint32_t b)
+{
+  return __QADD16(a, b);
+}
+
+// a.low * b.low + a.high * b.high + sum
+static inline int64_t multiply_add16(uint32_t a, uint32_t b, int64_t sum)
+{
+  return __SMLALD(a, b, sum);
+}
+
+static inline void cycle_counter_begin()
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cycle_count()
+{
+  return DWT->CYCCNT;
+}
+
+#else
+
+static inline int32_t saturate16(int32_t x)
+{
+  return x > 32767 ? 32767 : x < -32768 ? -32768 : x;
+}
+
+static inline uint32_t pack16(int32_t low, int32_t high)
+{
+  return (low & 0xFFFF) | ((uint32_t)high << 16);
+}
+
+static inline uint32_t add16(uint32_t a, uint32_t b)
+{
+  int32_t low = saturate16((int16_t)a + (int16_t)b);
+  int32_t high = saturate16((int16_t)(a >> 16) + (int16_t)(b >> 16));
+  return pack16(low, high);
+}
+
+static inline int64_t multiply_add16(uint32_t a, uint32_t b, int64_t sum)
+{
+  return sum + (int16_t)a * (int16_t)b + (int16_t)(a >> 16) * (int16_t)(b >> 16);
+}
+
+static inline void cycle_counter_begin()
+{
+}
+
+// microseconds rather than cycles off target
+static inline uint32_t cycle_count()
+{
+  return micros();
+}
+
+#endif
+
+static inline int32_t multiply_q31(int32_t a, int32_t b)
+{
+  return ((int64_t)a * b) >> 31;
+}
+
+#endif
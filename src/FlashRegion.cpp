@@ -0,0 +1,91 @@
+#include "FlashRegion.h"
+
+static const uint32_t crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+// standard CRC-32 (zlib), nibble table to keep it out of RAM
+uint32_t crc32(uint32_t crc, const void *data, uint32_t length)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  for (uint32_t i = 0; i < length; i++)
+  {
+    crc = crc_table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+    crc = crc_table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+FlashRegion::FlashRegion()
+{
+  address = 0;
+  size = 0;
+  is_ready = false;
+  _flash = NULL;
+  _transport = NULL;
+}
+
+void FlashRegion::begin(Adafruit_SPIFlash *flash, Adafruit_FlashTransport *transport, uint32_t region_address, uint32_t region_size)
+{
+  _flash = flash;
+  _transport = transport;
+  address = region_address;
+  size = region_size;
+  is_ready = true;
+}
+
+bool FlashRegion::is_busy()
+{
+  // bit 0 of status register 1 is WIP (write in progress)
+  return _flash->readStatus() & 0x01;
+}
+
+void FlashRegion::start_erase(uint32_t offset)
+{
+  // same sequence as Adafruit_SPIFlashBase::eraseSector() minus the wait
+  _transport->runCommand(SFLASH_CMD_WRITE_ENABLE);
+  _transport->eraseCommand(SFLASH_CMD_ERASE_SECTOR, address + offset);
+}
+
+void FlashRegion::write(uint32_t offset, const void *buffer, uint32_t length)
+{
+  _flash->writeBuffer(address + offset, (const uint8_t *)buffer, length);
+}
+
+void FlashRegion::read(uint32_t offset, void *buffer, uint32_t length)
+{
+  _flash->readBuffer(address + offset, (uint8_t *)buffer, length);
+}
+
+// Reads straight into the caller's buffer. On failure the buffer may be
+// clobbered and the caller has to rebuild it.
+bool FlashRegion::read_checked(uint32_t offset, void *buffer, uint32_t length, uint32_t crc)
+{
+  read(offset, buffer, length);
+  return crc32(0, buffer, length) == crc;
+}
+
+bool FlashRegion::read_header(uint32_t offset, void *header, uint32_t length, uint32_t magic, uint32_t version)
+{
+  uint32_t *words = (uint32_t *)header;
+  uint32_t count = length / sizeof(uint32_t);
+  read(offset, header, length);
+  return words[0] == magic &&
+         words[1] == version &&
+         words[count - 1] == crc32(0, header, length - sizeof(uint32_t));
+}
+
+// Fills in the trailing CRC and programs the header once the chip is idle.
+void FlashRegion::write_header(uint32_t offset, void *header, uint32_t length)
+{
+  uint32_t *words = (uint32_t *)header;
+  words[length / sizeof(uint32_t) - 1] = crc32(0, header, length - sizeof(uint32_t));
+  while (is_busy())
+  {
+  }
+  write(offset, header, length);
+}
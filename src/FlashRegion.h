@@ -0,0 +1,39 @@
+#ifndef FlashRegion_h
+#define FlashRegion_h
+
+#include "Arduino.h"
+#include <Adafruit_SPIFlash.h>
+
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_PAGE_SIZE 256
+
+// A window of the external QSPI flash. Erases are only started here so the
+// caller can keep servicing the MIDI clock while the chip is busy.
+//
+// Headers start with a magic and a version word and end with a CRC of the
+// words before it. They are written after the data they describe, so a
+// header only reads back valid once everything behind it is complete.
+class FlashRegion
+{
+  public:
+    FlashRegion();
+    uint32_t address;
+    uint32_t size;
+    bool is_ready;
+    void begin(Adafruit_SPIFlash *flash, Adafruit_FlashTransport *transport, uint32_t address, uint32_t size);
+    bool is_busy();
+    void start_erase(uint32_t offset);
+    void write(uint32_t offset, const void *buffer, uint32_t length);
+    void read(uint32_t offset, void *buffer, uint32_t length);
+    bool read_checked(uint32_t offset, void *buffer, uint32_t length, uint32_t crc);
+    bool read_header(uint32_t offset, void *header, uint32_t length, uint32_t magic, uint32_t version);
+    void write_header(uint32_t offset, void *header, uint32_t length);
+
+  private:
+    Adafruit_SPIFlash *_flash;
+    Adafruit_FlashTransport *_transport;
+};
+
+uint32_t crc32(uint32_t crc, const void *data, uint32_t length);
+
+#endif
@@ -0,0 +1,237 @@
+#include "History.h"
+
+#define ENTRY_CELL 1
+#define ENTRY_PARAM 2
+#define ENTRY_GROUP 3
+
+#define ENTRY_TYPE(word) ((word) >> 30)
+#define ENTRY_LENGTH(word) (((word) >> 22) & 0xFF)
+#define ENTRY(type, length, payload) (((uint32_t)(type) << 30) | ((uint32_t)(length) << 22) | (payload))
+
+#define BIT_ON 0x01
+#define BIT_ACCENT 0x02
+
+History::History()
+{
+  _tail = 0;
+  _cursor = 0;
+  _head = 0;
+  _is_suspended = false;
+  _saved_tail = 0;
+  _saved_cursor = 0;
+  _saved_head = 0;
+  _reach = 0;
+  _cells = NULL;
+  _count = 0;
+}
+
+uint8_t History::bits(Note &note)
+{
+  return (note.is_on ? BIT_ON : 0) | (note.is_accented ? BIT_ACCENT : 0);
+}
+
+void History::begin(Note *cells, int count, int *row_offset, int *last_step, int *swing)
+{
+  _cells = cells;
+  _count = min(count, MAX_HISTORY_CELLS);
+  _params[PARAM_ROW_OFFSET] = row_offset;
+  _params[PARAM_LAST_STEP] = last_step;
+  _params[PARAM_SWING] = swing;
+}
+
+uint32_t History::at(uint32_t position)
+{
+  return _journal[position & (JOURNAL_SIZE - 1)];
+}
+
+void History::append(const uint32_t *words, uint32_t length)
+{
+  // a new edit drops anything that could have been redone
+  _head = _cursor;
+  while (_head + length - _tail > JOURNAL_SIZE)
+  {
+    _tail += ENTRY_LENGTH(at(_tail));
+  }
+  for (uint32_t i = 0; i < length; i++)
+  {
+    _journal[(_head + i) & (JOURNAL_SIZE - 1)] = words[i];
+  }
+  _head += length;
+  _cursor = _head;
+  if (_head > _reach)
+  {
+    _reach = _head; // furthest written, for resume()
+  }
+}
+
+void History::record(Note &note, uint8_t old_bits)
+{
+  int index = &note - _cells;
+  uint8_t new_bits = bits(note);
+  if (_cells == NULL || index < 0 || index >= _count || old_bits == new_bits)
+  {
+    return;
+  }
+  uint32_t word = ENTRY(ENTRY_CELL, 1, (index << 4) | (old_bits << 2) | new_bits);
+  append(&word, 1);
+}
+
+void History::record_param(int param, int old_value, int new_value)
+{
+  if (old_value == new_value)
+  {
+    return;
+  }
+  uint32_t word = ENTRY(ENTRY_PARAM, 1, (param << 16) | ((old_value & 0xFF) << 8) | (new_value & 0xFF));
+  append(&word, 1);
+}
+
+// Multi-cell edits go between begin_group() and end_group() and are stored
+// as xor masks of the cells that actually changed.
+void History::begin_group()
+{
+  memset(_before_on, 0, sizeof(_before_on));
+  memset(_before_accent, 0, sizeof(_before_accent));
+  for (int i = 0; i < _count; i++)
+  {
+    _before_on[i / 32] |= (uint32_t)_cells[i].is_on << (i % 32);
+    _before_accent[i / 32] |= (uint32_t)_cells[i].is_accented << (i % 32);
+  }
+}
+
+void History::end_group()
+{
+  uint32_t words[2 + 3 * (MAX_HISTORY_CELLS / 32)];
+  uint32_t length = 1;
+  for (int w = 0; w < (_count + 31) / 32; w++)
+  {
+    uint32_t on = 0;
+    uint32_t accent = 0;
+    for (int i = w * 32; i < min(_count, (w + 1) * 32); i++)
+    {
+      on |= (uint32_t)_cells[i].is_on << (i % 32);
+      accent |= (uint32_t)_cells[i].is_accented << (i % 32);
+    }
+    on ^= _before_on[w];
+    accent ^= _before_accent[w];
+    if (on || accent)
+    {
+      words[length++] = w;
+      words[length++] = on;
+      words[length++] = accent;
+    }
+  }
+  if (length == 1)
+  {
+    return;
+  }
+  length++;
+  words[0] = ENTRY(ENTRY_GROUP, length, 0);
+  words[length - 1] = words[0];
+  append(words, length);
+}
+
+void History::set_bits(int index, uint8_t bits)
+{
+  _cells[index].is_on = bits & BIT_ON;
+  _cells[index].is_accented = bits & BIT_ACCENT;
+}
+
+void History::apply(uint32_t position, bool is_undo)
+{
+  uint32_t word = at(position);
+  switch (ENTRY_TYPE(word))
+  {
+  case ENTRY_CELL:
+    set_bits((word >> 4) & 0x3FF, is_undo ? (word >> 2) & 0x03 : word & 0x03);
+    break;
+  case ENTRY_PARAM:
+    *_params[(word >> 16) & 0x0F] = is_undo ? (word >> 8) & 0xFF : word & 0xFF;
+    break;
+  case ENTRY_GROUP:
+    // xor masks are their own inverse, only the changed bits are visited
+    for (uint32_t i = 1; i + 1 < ENTRY_LENGTH(word); i += 3)
+    {
+      int base = at(position + i) * 32;
+      uint32_t on = at(position + i + 1);
+      uint32_t accent = at(position + i + 2);
+      uint32_t changed = on | accent;
+      while (changed)
+      {
+        int bit = __builtin_ctz(changed);
+        changed &= changed - 1;
+        _cells[base + bit].is_on ^= (on >> bit) & 1;
+        _cells[base + bit].is_accented ^= (accent >> bit) & 1;
+      }
+    }
+    break;
+  }
+}
+
+bool History::undo()
+{
+  if (_cursor == _tail)
+  {
+    return false;
+  }
+  _cursor -= ENTRY_LENGTH(at(_cursor - 1));
+  apply(_cursor, true);
+  return true;
+}
+
+bool History::redo()
+{
+  if (_cursor == _head)
+  {
+    return false;
+  }
+  apply(_cursor, false);
+  _cursor += ENTRY_LENGTH(at(_cursor));
+  return true;
+}
+
+void History::suspend()
+{
+  if (_is_suspended)
+  {
+    return;
+  }
+  _saved_tail = _tail;
+  _saved_cursor = _cursor;
+  _saved_head = _head;
+  _reach = _head;
+  _tail = _head;
+  _cursor = _head;
+  _is_suspended = true;
+}
+
+// Brings back the entries from before suspend(). Whatever was recorded in
+// between may have wrapped over the oldest of them, so the journal is
+// walked back from the end and cut at the first entry that is not intact.
+void History::resume()
+{
+  if (!_is_suspended)
+  {
+    return;
+  }
+  uint32_t start = _saved_head;
+  while (start != _saved_tail && _reach - (start - 1) <= JOURNAL_SIZE)
+  {
+    uint32_t length = ENTRY_LENGTH(at(start - 1));
+    if (_reach - (start - length) > JOURNAL_SIZE)
+    {
+      break;
+    }
+    start -= length;
+  }
+  _tail = start;
+  _head = _saved_head;
+  _cursor = _saved_cursor;
+  if (_tail > _cursor)
+  {
+    // the redo entries lost their start, drop the rest with them
+    _tail = _head;
+    _cursor = _head;
+  }
+  _is_suspended = false;
+}
@@ -0,0 +1,66 @@
+#ifndef History_h
+#define History_h
+
+#include "Arduino.h"
+#include "Note.h"
+
+#define JOURNAL_SIZE 512 // words, must be a power of two
+#define MAX_HISTORY_CELLS 1024
+
+enum HistoryParam
+{
+  PARAM_ROW_OFFSET,
+  PARAM_LAST_STEP,
+  PARAM_SWING,
+  NUMBER_OF_PARAMS
+};
+
+// Undo/redo journal of grid and parameter edits, kept as deltas in a fixed
+// ring of words. Every entry starts and ends with a word holding its type and
+// length, so it can be walked in both directions; the oldest entries are
+// dropped when the ring is full.
+//
+//   cell:  one word, cell index with old and new on/accent bits
+//   param: one word, parameter id with old and new value
+//   group: header, then (mask index, on xor, accent xor) for every 32 cell
+//          mask word that changed, then the header again
+//
+// suspend() sets the journal aside while something else borrows the cells,
+// edits made until resume() can only undo among themselves.
+class History
+{
+  public:
+    History();
+    static uint8_t bits(Note &note);
+    void begin(Note *cells, int count, int *row_offset, int *last_step, int *swing);
+    void record(Note &note, uint8_t old_bits);
+    void record_param(int param, int old_value, int new_value);
+    void begin_group();
+    void end_group();
+    bool undo();
+    bool redo();
+    void suspend();
+    void resume();
+
+  private:
+    uint32_t _journal[JOURNAL_SIZE];
+    uint32_t _tail;
+    uint32_t _cursor;
+    uint32_t _head;
+    bool _is_suspended;
+    uint32_t _saved_tail;
+    uint32_t _saved_cursor;
+    uint32_t _saved_head;
+    uint32_t _reach;
+    Note *_cells;
+    int _count;
+    int *_params[NUMBER_OF_PARAMS];
+    uint32_t _before_on[MAX_HISTORY_CELLS / 32];
+    uint32_t _before_accent[MAX_HISTORY_CELLS / 32];
+    uint32_t at(uint32_t position);
+    void append(const uint32_t *words, uint32_t length);
+    void set_bits(int index, uint8_t bits);
+    void apply(uint32_t position, bool is_undo);
+};
+
+#endif
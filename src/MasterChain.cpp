@@ -0,0 +1,60 @@
+#include "MasterChain.h"
+
+static const int16_t silence[AUDIO_BLOCK_SAMPLES] = {0};
+
+MasterChain::MasterChain() : AudioStream(2, inputQueueArray)
+{
+  cycles = 0;
+  max_cycles = 0;
+}
+
+void MasterChain::control(int control, uint8_t value)
+{
+  _effects.control(control, value);
+}
+
+void MasterChain::set_clock_period(uint32_t microseconds)
+{
+  _effects.set_clock_period(microseconds);
+}
+
+uint32_t MasterChain::delay_length()
+{
+  return _effects.delay_length();
+}
+
+void MasterChain::update(void)
+{
+  uint32_t start = cycle_count();
+  audio_block_t *block = receiveWritable(0);
+  audio_block_t *send_block = receiveReadOnly(1);
+  if (block == NULL)
+  {
+    block = allocate();
+    if (block == NULL)
+    {
+      if (send_block)
+      {
+        release(send_block);
+      }
+      return;
+    }
+    memset(block->data, 0, sizeof(block->data));
+  }
+  const int16_t *send = send_block ? send_block->data : silence;
+
+  _effects.process(block->data, send);
+
+  transmit(block, 0);
+  release(block);
+  if (send_block)
+  {
+    release(send_block);
+  }
+
+  cycles = cycle_count() - start;
+  if (cycles > max_cycles)
+  {
+    max_cycles = cycles;
+  }
+}
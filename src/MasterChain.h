@@ -0,0 +1,26 @@
+#ifndef MasterChain_h
+#define MasterChain_h
+
+#include "Arduino.h"
+#include <Audio.h>
+#include "MasterEffects.h"
+
+// MasterEffects as an audio library stream: input 0 is the dry mix, input 1
+// the delay send.
+class MasterChain : public AudioStream
+{
+  public:
+    MasterChain();
+    uint32_t cycles;
+    uint32_t max_cycles;
+    void control(int control, uint8_t value);
+    void set_clock_period(uint32_t microseconds);
+    uint32_t delay_length();
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[2];
+    MasterEffects _effects;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "MasterEffects.h"
+#include <math.h>
+
+#define COMPRESSOR_RATIO 4
+#define COMPRESSOR_RELEASE 0.9f // level kept per block while falling
+
+static int16_t delay_pool[DELAY_POOL_SAMPLES];
+
+MasterEffects::MasterEffects()
+{
+  memset(delay_pool, 0, sizeof(delay_pool)); // a new chain starts without repeats
+  _write = 0;
+  _level = 0;
+  _gain = 1 << 14;
+  _target_length = (uint32_t)(AUDIO_SAMPLE_RATE_EXACT / 4); // an eighth note at 120 BPM
+  _length = _target_length << 16;
+  control(MASTER_CRUSH, 0);
+  control(MASTER_FEEDBACK, 48);
+  control(MASTER_DELAY_MIX, 40);
+  control(MASTER_COMPRESSOR, 0);
+}
+
+// Takes a 0 to 127 controller value.
+void MasterEffects::control(int control, uint8_t value)
+{
+  switch (control)
+  {
+  case MASTER_CRUSH:
+  {
+    // 16 bits down to 4, holding each sample for up to 8
+    uint32_t mask = (0xFFFF << (value * 12 / 127)) & 0xFFFF;
+    _crush_mask = mask | (mask << 16);
+    _crush_hold = ~((1u << (value * 3 / 127)) - 1);
+    break;
+  }
+  case MASTER_FEEDBACK:
+    _feedback = value * 29000 / 127;
+    break;
+  case MASTER_DELAY_MIX:
+    _wet = value * 32767 / 127;
+    break;
+  case MASTER_COMPRESSOR:
+  {
+    // threshold from full scale down to -24 dB, made up halfway
+    float threshold = powf(10.0f, -24.0f * value / 127 / 20.0f);
+    _threshold = threshold * threshold;
+    _makeup = 1.0f / sqrtf(threshold);
+    break;
+  }
+  }
+}
+
+// Follows the MIDI clock, one tick is 1/24 of a quarter note. The clock
+// period is already smoothed but still jitters by more than the ear allows
+// for a delay, so only a change past DELAY_TOLERANCE moves the target.
+void MasterEffects::set_clock_period(uint32_t microseconds)
+{
+  if (microseconds == 0)
+  {
+    return;
+  }
+  uint32_t length = (uint64_t)microseconds * 12 * (uint32_t)AUDIO_SAMPLE_RATE_EXACT / 1000000;
+  while (length >= DELAY_POOL_SAMPLES)
+  {
+    length /= 2;
+  }
+  uint32_t target = _target_length;
+  uint32_t difference = length > target ? length - target : target - length;
+  if (difference > target / DELAY_TOLERANCE)
+  {
+    _target_length = length;
+  }
+}
+
+// samples, where the read position is now
+uint32_t MasterEffects::delay_length()
+{
+  return _length >> 16;
+}
+
+// Runs one block in place, data is the dry mix and must be word aligned.
+void MasterEffects::process(int16_t *data, const int16_t *send)
+{
+  // feedback delay, read between two samples as the length glides
+  int16_t wet[AUDIO_BLOCK_SAMPLES] __attribute__((aligned(4)));
+  int32_t glide = ((int32_t)(_target_length << 16) - (int32_t)_length);
+  glide = max(-DELAY_GLIDE * AUDIO_BLOCK_SAMPLES, min(glide, DELAY_GLIDE * AUDIO_BLOCK_SAMPLES));
+  int32_t length_step = glide / AUDIO_BLOCK_SAMPLES;
+  uint32_t length = _length;
+  int32_t feedback = _feedback;
+  int32_t wet_level = _wet;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+  {
+    uint32_t position = (_write << 16) - length;
+    uint32_t index = position >> 16;
+    int32_t fraction = (position & 0xFFFF) >> 1; // Q15, keeps the product in 32 bits
+    int32_t before = delay_pool[index & (DELAY_POOL_SAMPLES - 1)];
+    int32_t after = delay_pool[(index + 1) & (DELAY_POOL_SAMPLES - 1)];
+    int32_t delayed = before + (((after - before) * fraction) >> 15);
+    delay_pool[_write & (DELAY_POOL_SAMPLES - 1)] = saturate16(send[i] + ((delayed * feedback) >> 15));
+    wet[i] = (delayed * wet_level) >> 15;
+    length += length_step;
+    _write++;
+  }
+  _length = length;
+  uint32_t *words = (uint32_t *)data;
+  const uint32_t *wet_words = (const uint32_t *)wet;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++)
+  {
+    words[i] = add16(words[i], wet_words[i]);
+  }
+
+  // compressor, level from the block's mean square
+  int64_t sum = 0;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++)
+  {
+    sum = multiply_add16(words[i], words[i], sum);
+  }
+  float level = sum / (AUDIO_BLOCK_SAMPLES * 1073741824.0f);
+  _level = level > _level ? level : _level * COMPRESSOR_RELEASE;
+  float gain = _makeup;
+  if (_level > _threshold)
+  {
+    // mean square, so the exponent is halved
+    gain *= powf(_threshold / _level, 0.5f * (1.0f - 1.0f / COMPRESSOR_RATIO));
+  }
+  int32_t target = min(gain * (1 << 14), 65535.0f); // keeps sample * gain in 32 bits
+  int32_t gain_step = (target - _gain) / AUDIO_BLOCK_SAMPLES;
+  int32_t current = _gain;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+  {
+    data[i] = saturate16((data[i] * current) >> 14);
+    current += gain_step;
+  }
+  _gain = target;
+
+  // bitcrusher, sample and hold then drop the low bits of both halves
+  uint32_t hold = _crush_hold;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+  {
+    data[i] = data[i & hold];
+  }
+  uint32_t mask = _crush_mask;
+  for (int i = 0; i < AUDIO_BLOCK_SAMPLES / 2; i++)
+  {
+    words[i] &= mask;
+  }
+}
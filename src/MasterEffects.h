@@ -0,0 +1,56 @@
+#ifndef MasterEffects_h
+#define MasterEffects_h
+
+#include "Arduino.h"
+#include <AudioStream.h>
+#include "Dsp.h"
+
+#define DELAY_POOL_SAMPLES 16384 // must be a power of two, 0.37 s at 44.1 kHz
+#define DELAY_TOLERANCE 32 // length changes under 1/32 are clock jitter
+#define DELAY_GLIDE 4096 // Q16 samples per sample the read position may drift
+
+enum MasterControl
+{
+  MASTER_CRUSH,
+  MASTER_FEEDBACK,
+  MASTER_DELAY_MIX,
+  MASTER_COMPRESSOR,
+  NUMBER_OF_MASTER_CONTROLS
+};
+
+// Master bus: the send input runs through a feedback delay of one eighth
+// note at the current tempo, is mixed with the dry input, then goes through
+// a compressor and a bitcrusher. Levels are worked out once per block and
+// ramped or masked across it, so the sample loops do not branch. The delay
+// line lives in a static pool, so there is only one of these.
+//
+// A tempo change glides the delay read position rather than jumping it,
+// which pitch bends the repeats briefly instead of clicking. Once an eighth
+// note no longer fits the pool, below about 81 BPM, the delay falls back to
+// a sixteenth, and to a 32nd below about 40 BPM.
+//
+// Only the block kernel, MasterChain feeds it to the audio library.
+class MasterEffects
+{
+  public:
+    MasterEffects();
+    void control(int control, uint8_t value);
+    void set_clock_period(uint32_t microseconds);
+    uint32_t delay_length();
+    void process(int16_t *data, const int16_t *send);
+
+  private:
+    volatile uint32_t _target_length;
+    volatile int32_t _feedback; // Q15
+    volatile int32_t _wet;      // Q15
+    volatile float _threshold;  // mean square, full scale is 1
+    volatile float _makeup;
+    volatile uint32_t _crush_mask;
+    volatile uint32_t _crush_hold;
+    uint32_t _write;
+    uint32_t _length; // Q16 samples
+    float _level;
+    int32_t _gain; // Q14
+};
+
+#endif
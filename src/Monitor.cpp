@@ -0,0 +1,304 @@
+#include "Monitor.h"
+
+Monitor::Monitor()
+{
+  max_loop_time = 0;
+  clock_period = 0;
+  late_ticks = 0;
+  merged_ticks = 0;
+  overruns = 0;
+  _repeat_drops = NULL;
+  _loop_start = 0;
+  _last_clock = 0;
+  _has_last_clock = false;
+  _misses = 0;
+  _steady = 0;
+  _sysex_length = 0;
+}
+
+// counters kept by other modules that are reported alongside
+void Monitor::begin(uint32_t *repeat_drops)
+{
+  _repeat_drops = repeat_drops;
+}
+
+#if defined(__arm__)
+// provided by the linker script and newlib
+extern "C" char __data_start__;
+extern "C" char __bss_end__;
+extern "C" char __end__;
+extern "C" char __StackTop;
+extern "C" char *sbrk(int incr);
+
+// Call first thing in setup(), everything below this frame is still unused.
+void Monitor::paint_stack()
+{
+  uint32_t *word = (uint32_t *)(((uintptr_t)sbrk(0) + 3) & ~3);
+  uint32_t *top = (uint32_t *)__builtin_frame_address(0) - 16;
+  while (word < top)
+  {
+    *word++ = STACK_PAINT;
+  }
+}
+
+uint32_t Monitor::stack_used()
+{
+  uint32_t *word = (uint32_t *)(((uintptr_t)sbrk(0) + 3) & ~3);
+  while (word < (uint32_t *)&__StackTop && *word == STACK_PAINT)
+  {
+    word++;
+  }
+  return &__StackTop - (char *)word;
+}
+
+// untouched RAM between the heap and the deepest the stack has been
+uint32_t Monitor::stack_free()
+{
+  return &__StackTop - sbrk(0) - stack_used();
+}
+
+uint32_t Monitor::static_used()
+{
+  return &__bss_end__ - &__data_start__;
+}
+
+uint32_t Monitor::heap_used()
+{
+  return sbrk(0) - &__end__;
+}
+
+#else
+// host builds have no linker symbols to measure against, the memory
+// watermarks read zero there
+void Monitor::paint_stack()
+{
+}
+
+uint32_t Monitor::stack_used()
+{
+  return 0;
+}
+
+uint32_t Monitor::stack_free()
+{
+  return 0;
+}
+
+uint32_t Monitor::static_used()
+{
+  return 0;
+}
+
+uint32_t Monitor::heap_used()
+{
+  return 0;
+}
+#endif
+
+void Monitor::loop_start()
+{
+  _loop_start = micros();
+}
+
+void Monitor::loop_end()
+{
+  uint32_t loop_time = micros() - _loop_start;
+  if (loop_time > max_loop_time)
+  {
+    max_loop_time = loop_time;
+  }
+  if (clock_period > 0 && loop_time > clock_period)
+  {
+    overruns++;
+  }
+}
+
+// Clock packets are read once per loop() pass, so a slow pass shows up as a
+// tick handled well after its period, followed by the queued ones handled
+// back to back. A run of intervals off the period is a tempo change rather
+// than a slow pass, so the period is measured again.
+void Monitor::clock()
+{
+  unsigned long now = micros();
+  uint32_t interval = now - _last_clock;
+  _last_clock = now;
+  if (!_has_last_clock)
+  {
+    // nothing to measure against yet
+    _has_last_clock = true;
+    return;
+  }
+
+  if (clock_period == 0)
+  {
+    clock_period = interval;
+    _misses = 0;
+    _steady = 0;
+  }
+  else if (interval > clock_period * 4)
+  {
+    // the clock was paused or the tempo dropped, measure it again
+    clock_period = 0;
+  }
+  else if (interval < clock_period / 4)
+  {
+    merged_ticks++;
+    _misses++;
+  }
+  else if (interval > clock_period * 3 / 2)
+  {
+    late_ticks++;
+    _misses++;
+  }
+  else
+  {
+    clock_period = clock_period - clock_period / 8 + interval / 8;
+    _misses = 0;
+    if (_steady < CLOCK_STEADY_TICKS)
+    {
+      _steady++;
+    }
+  }
+  if (_misses >= CLOCK_MISS_LIMIT)
+  {
+    clock_period = 0;
+  }
+}
+
+// The first period is a single interval, which USB frames alone make
+// jitter by a millisecond, so it takes a quarter note of intervals on the
+// period before it is good enough to set the delay from.
+bool Monitor::is_clock_steady()
+{
+  return clock_period > 0 && _steady >= CLOCK_STEADY_TICKS;
+}
+
+// Call on start and continue, the gap since the last clock is not a period.
+void Monitor::restart()
+{
+  _has_last_clock = false;
+  _misses = 0;
+}
+
+// Watches for the request F0 7D 01 F7, which arrives as a SysEx start
+// packet followed by an end packet.
+bool Monitor::handle_sysex(midiEventPacket_t packet)
+{
+  uint8_t bytes[3] = {packet.byte1, packet.byte2, packet.byte3};
+  int count;
+  switch (packet.header & 0x0F)
+  {
+  case 0x04: // start or continue
+    count = 3;
+    break;
+  case 0x05: // end with one byte
+    count = 1;
+    break;
+  case 0x06:
+    count = 2;
+    break;
+  case 0x07:
+    count = 3;
+    break;
+  default:
+    return false;
+  }
+  for (int i = 0; i < count; i++)
+  {
+    if (bytes[i] == 0xF0)
+    {
+      _sysex_length = 0;
+    }
+    if (_sysex_length < (int)sizeof(_sysex))
+    {
+      _sysex[_sysex_length] = bytes[i];
+    }
+    _sysex_length++;
+  }
+  if ((packet.header & 0x0F) == 0x04)
+  {
+    return false;
+  }
+  bool is_request = _sysex_length == 4 &&
+                    _sysex[0] == 0xF0 &&
+                    _sysex[1] == SYSEX_ID &&
+                    _sysex[2] == SYSEX_MONITOR_REQUEST &&
+                    _sysex[3] == 0xF7;
+  _sysex_length = 0;
+  return is_request;
+}
+
+// Replies with F0 7D 02, then every value as five 7 bit bytes LSB first,
+// then F7.
+void Monitor::send_sysex()
+{
+  uint32_t values[] = {
+      stack_used(),
+      stack_free(),
+      static_used(),
+      heap_used(),
+      max_loop_time,
+      clock_period,
+      late_ticks,
+      merged_ticks,
+      overruns,
+      _repeat_drops ? *_repeat_drops : 0,
+  };
+  const int count = sizeof(values) / sizeof(values[0]);
+  uint8_t message[3 + count * 5 + 1];
+  int length = 0;
+  message[length++] = 0xF0;
+  message[length++] = SYSEX_ID;
+  message[length++] = SYSEX_MONITOR_REPLY;
+  for (int i = 0; i < count; i++)
+  {
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+      message[length++] = (values[i] >> shift) & 0x7F;
+    }
+  }
+  message[length++] = 0xF7;
+
+  for (int i = 0; i < length; i += 3)
+  {
+    int remaining = length - i;
+    midiEventPacket_t packet = {0x04, message[i], 0, 0};
+    if (remaining <= 3)
+    {
+      packet.header = 0x04 + remaining; // 0x05 to 0x07 end the message
+    }
+    if (remaining > 1)
+    {
+      packet.byte2 = message[i + 1];
+    }
+    if (remaining > 2)
+    {
+      packet.byte3 = message[i + 2];
+    }
+    MidiUSB.sendMIDI(packet);
+  }
+}
+
+void Monitor::report()
+{
+  Serial.print("stack used: ");
+  Serial.println(stack_used());
+  Serial.print("stack free: ");
+  Serial.println(stack_free());
+  Serial.print("static: ");
+  Serial.println(static_used());
+  Serial.print("heap: ");
+  Serial.println(heap_used());
+  Serial.print("max loop us: ");
+  Serial.println(max_loop_time);
+  Serial.print("clock period us: ");
+  Serial.println(clock_period);
+  Serial.print("late ticks: ");
+  Serial.println(late_ticks);
+  Serial.print("merged ticks: ");
+  Serial.println(merged_ticks);
+  Serial.print("loop overruns: ");
+  Serial.println(overruns);
+  Serial.print("repeat drops: ");
+  Serial.println(_repeat_drops ? *_repeat_drops : 0);
+}
@@ -0,0 +1,52 @@
+#ifndef Monitor_h
+#define Monitor_h
+
+#include "Arduino.h"
+#include <MIDIUSB.h>
+
+#define STACK_PAINT 0xA5A5A5A5
+#define SYSEX_ID 0x7D // non-commercial
+#define SYSEX_MONITOR_REQUEST 0x01
+#define SYSEX_MONITOR_REPLY 0x02
+#define CLOCK_MISS_LIMIT 8 // intervals in a row off the period before it is measured again
+#define CLOCK_STEADY_TICKS 24 // intervals on the period before it is trusted
+
+// Memory and timing watermarks. The free RAM between the heap and the stack
+// is painted at boot, so the deepest the stack has reached can be found
+// later by looking for the first word that changed.
+class Monitor
+{
+  public:
+    Monitor();
+    uint32_t max_loop_time;
+    uint32_t clock_period;
+    uint32_t late_ticks;
+    uint32_t merged_ticks;
+    uint32_t overruns;
+    void begin(uint32_t *repeat_drops);
+    void paint_stack();
+    uint32_t stack_used();
+    uint32_t stack_free();
+    uint32_t static_used();
+    uint32_t heap_used();
+    void loop_start();
+    void loop_end();
+    void clock();
+    void restart();
+    bool is_clock_steady();
+    bool handle_sysex(midiEventPacket_t packet);
+    void send_sysex();
+    void report();
+
+  private:
+    uint32_t *_repeat_drops;
+    unsigned long _loop_start;
+    unsigned long _last_clock;
+    bool _has_last_clock;
+    int _misses;
+    int _steady;
+    uint8_t _sysex[4];
+    int _sysex_length;
+};
+
+#endif
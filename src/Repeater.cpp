@@ -0,0 +1,162 @@
+#include "Repeater.h"
+
+Repeater::Repeater()
+{
+  rate = 0;
+  order = REPEAT_ALL;
+  held = 0;
+  dropped = 0;
+  _head = 0;
+  _tail = 0;
+  _now = 0;
+  _last_clock = 0;
+  _period = 0;
+  _is_half_done = true;
+  _position = -1;
+  _random = 0x12345678;
+}
+
+bool Repeater::is_enabled()
+{
+  return rate > 0;
+}
+
+void Repeater::hold(int pad)
+{
+  if (pad >= 0 && pad < REPEAT_PADS)
+  {
+    held |= 1 << pad;
+  }
+}
+
+void Repeater::release(int pad)
+{
+  if (pad >= 0 && pad < REPEAT_PADS)
+  {
+    held &= ~(1 << pad);
+  }
+}
+
+// the note-offs already queued still go out, so nothing is left hanging
+void Repeater::release_all()
+{
+  held = 0;
+}
+
+void Repeater::clock(uint32_t tick, unsigned long now)
+{
+  if (_last_clock != 0 && now - _last_clock < 100000)
+  {
+    _period = now - _last_clock;
+  }
+  _last_clock = now;
+  if (!_is_half_done && tick * 2 == _now + 2)
+  {
+    // update() never got to the odd half tick before this clock
+    step(_now + 1);
+  }
+  _is_half_done = false;
+  step(tick * 2);
+}
+
+void Repeater::update(unsigned long now)
+{
+  if (!_is_half_done && _period > 0 && now - _last_clock >= _period / 2)
+  {
+    _is_half_done = true;
+    step(_now + 1);
+  }
+}
+
+// Queues the notes for this step, then their note-offs half a step later,
+// so the queue stays in time order since the gate is shorter than the step.
+void Repeater::step(uint32_t half_tick)
+{
+  _now = half_tick;
+  if (!is_enabled() || held == 0 || half_tick % rate != 0)
+  {
+    return;
+  }
+
+  uint16_t pads = order == REPEAT_ALL ? held : 1 << next_pad();
+  uint32_t count = __builtin_popcount(pads);
+  if (_tail - _head + 2 * count > REPEAT_QUEUE_SIZE)
+  {
+    dropped += count;
+    return;
+  }
+  push(half_tick, pads, REPEAT_VELOCITY);
+  push(half_tick + max(rate / 2, 1), pads, 0);
+}
+
+void Repeater::push(uint32_t when, uint16_t pads, uint8_t velocity)
+{
+  while (pads)
+  {
+    RepeatEvent &event = _queue[_tail++ & (REPEAT_QUEUE_SIZE - 1)];
+    event.when = when;
+    event.pad = __builtin_ctz(pads);
+    event.velocity = velocity;
+    pads &= pads - 1;
+  }
+}
+
+int Repeater::next_pad()
+{
+  uint32_t pads = held;
+  switch (order)
+  {
+  case REPEAT_UP:
+  {
+    uint32_t above = pads & (0xFFFFu << (_position + 1));
+    _position = __builtin_ctz(above ? above : pads);
+    break;
+  }
+  case REPEAT_DOWN:
+  {
+    uint32_t below = _position < 0 ? 0 : pads & ((1u << _position) - 1);
+    _position = 31 - __builtin_clz(below ? below : pads);
+    break;
+  }
+  default:
+  {
+    // xorshift32, then the n-th held pad
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    int n = _random % __builtin_popcount(pads);
+    while (n--)
+    {
+      pads &= pads - 1;
+    }
+    _position = __builtin_ctz(pads);
+    break;
+  }
+  }
+  return _position;
+}
+
+bool Repeater::next_event(uint8_t *pad, uint8_t *velocity)
+{
+  if (_head == _tail)
+  {
+    return false;
+  }
+  RepeatEvent &event = _queue[_head & (REPEAT_QUEUE_SIZE - 1)];
+  if ((int32_t)(_now - event.when) < 0)
+  {
+    return false;
+  }
+  *pad = event.pad;
+  *velocity = event.velocity;
+  _head++;
+  return true;
+}
+
+// Drops everything queued, for when the caller cuts all notes itself.
+void Repeater::clear()
+{
+  _head = _tail;
+  _position = -1;
+  _is_half_done = true; // no half step of the old position either
+}
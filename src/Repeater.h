@@ -0,0 +1,62 @@
+#ifndef Repeater_h
+#define Repeater_h
+
+#include "Arduino.h"
+
+#define REPEAT_QUEUE_SIZE 32 // must be a power of two
+#define REPEAT_PADS 16
+#define REPEAT_VELOCITY 96
+
+enum RepeatOrder
+{
+  REPEAT_ALL,
+  REPEAT_UP,
+  REPEAT_DOWN,
+  REPEAT_RANDOM
+};
+
+struct RepeatEvent
+{
+  uint32_t when; // half ticks
+  uint8_t pad;
+  uint8_t velocity; // 0 is a note off
+};
+
+// Clock synced note repeat and arpeggiator over the held pads. Time is
+// counted in half ticks (48 per quarter note) so 1/64 notes fit; the odd
+// half tick is placed halfway to the next clock using the last clock
+// interval. Generated notes and their note-offs go through a fixed queue
+// that is drained with next_event().
+class Repeater
+{
+  public:
+    Repeater();
+    int rate; // half ticks between notes, 0 is off
+    int order;
+    uint16_t held;
+    uint32_t dropped;
+    bool is_enabled();
+    void hold(int pad);
+    void release(int pad);
+    void release_all();
+    void clock(uint32_t tick, unsigned long now);
+    void update(unsigned long now);
+    bool next_event(uint8_t *pad, uint8_t *velocity);
+    void clear();
+
+  private:
+    RepeatEvent _queue[REPEAT_QUEUE_SIZE];
+    uint32_t _head;
+    uint32_t _tail;
+    uint32_t _now;
+    unsigned long _last_clock;
+    unsigned long _period;
+    bool _is_half_done;
+    int _position;
+    uint32_t _random;
+    void step(uint32_t half_tick);
+    void push(uint32_t when, uint16_t pads, uint8_t velocity);
+    int next_pad();
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "Session.h"
+
+Session::Session()
+{
+  sequence = 0;
+  _region = NULL;
+  _patterns = NULL;
+  _length = 0;
+  _state = IDLE;
+  _is_dirty = false;
+  _last_change = 0;
+  _active_slot = 1;
+  _slot = 0;
+  _position = 0;
+  _crc = 0;
+}
+
+// header page followed by the pattern data, rounded up to whole sectors
+uint32_t Session::slot_size(uint32_t length)
+{
+  uint32_t size = FLASH_PAGE_SIZE + length;
+  return ((size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE) * FLASH_SECTOR_SIZE;
+}
+
+void Session::begin(FlashRegion *region, void *patterns, uint32_t length, int *row_offset, int *last_step, int *swing)
+{
+  _region = region;
+  _patterns = (uint8_t *)patterns;
+  _length = length;
+  _row_offset = row_offset;
+  _last_step = last_step;
+  _swing = swing;
+}
+
+uint32_t Session::slot_address(int slot)
+{
+  return slot * slot_size(_length);
+}
+
+// Reads the newest valid snapshot straight into the pattern storage, see
+// FlashRegion::read_checked() for what is left behind on failure.
+bool Session::restore()
+{
+  if (_region == NULL || !_region->is_ready)
+  {
+    return false;
+  }
+
+  SessionHeader headers[2];
+  bool is_valid[2];
+  for (int slot = 0; slot < 2; slot++)
+  {
+    is_valid[slot] = _region->read_header(slot_address(slot), &headers[slot], sizeof(SessionHeader), SESSION_MAGIC, SESSION_VERSION) &&
+                     headers[slot].length == _length;
+  }
+
+  int first = (is_valid[1] && (!is_valid[0] || headers[1].sequence > headers[0].sequence)) ? 1 : 0;
+  for (int attempt = 0; attempt < 2; attempt++)
+  {
+    int slot = attempt == 0 ? first : 1 - first;
+    if (!is_valid[slot])
+    {
+      continue;
+    }
+    if (_region->read_checked(slot_address(slot) + FLASH_PAGE_SIZE, _patterns, _length, headers[slot].crc))
+    {
+      *_row_offset = headers[slot].row_offset;
+      *_last_step = headers[slot].last_step;
+      *_swing = headers[slot].swing;
+      sequence = headers[slot].sequence;
+      _active_slot = slot;
+      _is_dirty = false;
+      _state = IDLE;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Session::mark_dirty()
+{
+  _is_dirty = true;
+  _last_change = millis();
+  // a save in progress would mix old and new state, start over once idle
+  _state = IDLE;
+}
+
+bool Session::is_saving()
+{
+  return _state != IDLE;
+}
+
+// Advances the background save by at most one sector erase or one page
+// write, so a pass through loop() never waits on the flash for long.
+void Session::update()
+{
+  if (_region == NULL || !_region->is_ready)
+  {
+    return;
+  }
+
+  switch (_state)
+  {
+  case IDLE:
+    if (_is_dirty && millis() - _last_change >= SESSION_IDLE_TIME && !_region->is_busy())
+    {
+      _slot = 1 - _active_slot;
+      _position = 0;
+      _region->start_erase(slot_address(_slot));
+      _state = ERASING;
+    }
+    break;
+  case ERASING:
+    if (_region->is_busy())
+    {
+      break;
+    }
+    _position += FLASH_SECTOR_SIZE;
+    if (_position < slot_size(_length))
+    {
+      _region->start_erase(slot_address(_slot) + _position);
+    }
+    else
+    {
+      _position = 0;
+      _crc = 0;
+      _state = WRITING;
+    }
+    break;
+  case WRITING:
+    if (_region->is_busy())
+    {
+      break;
+    }
+    if (_position < _length)
+    {
+      uint32_t length = min((uint32_t)FLASH_PAGE_SIZE, _length - _position);
+      _region->write(slot_address(_slot) + FLASH_PAGE_SIZE + _position, _patterns + _position, length);
+      _crc = crc32(_crc, _patterns + _position, length);
+      _position += length;
+    }
+    else
+    {
+      write_header();
+      _active_slot = _slot;
+      _is_dirty = false;
+      _state = IDLE;
+    }
+    break;
+  }
+}
+
+// Finishes any pending save before returning, for when the pattern storage
+// is about to be borrowed.
+void Session::save_now()
+{
+  if (_region == NULL || !_region->is_ready)
+  {
+    return;
+  }
+  _last_change = millis() - SESSION_IDLE_TIME;
+  while (_is_dirty)
+  {
+    update();
+  }
+}
+
+void Session::write_header()
+{
+  SessionHeader header;
+  header.magic = SESSION_MAGIC;
+  header.version = SESSION_VERSION;
+  header.sequence = sequence + 1;
+  header.length = _length;
+  header.crc = _crc;
+  header.row_offset = *_row_offset;
+  header.last_step = *_last_step;
+  header.swing = *_swing;
+  _region->write_header(slot_address(_slot), &header, sizeof(SessionHeader));
+  sequence = header.sequence;
+}
@@ -0,0 +1,64 @@
+#ifndef Session_h
+#define Session_h
+
+#include "Arduino.h"
+#include "FlashRegion.h"
+
+#define SESSION_MAGIC 0x53455353 // "SESS"
+#define SESSION_VERSION 1
+#define SESSION_IDLE_TIME 3000
+
+struct SessionHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t sequence;
+  uint32_t length;
+  uint32_t crc;
+  int32_t row_offset;
+  int32_t last_step;
+  int32_t swing;
+  uint32_t header_crc;
+};
+
+// Snapshots the pattern storage and the step parameters into one of two
+// flash slots once the state has been idle for SESSION_IDLE_TIME. The slots
+// alternate, so an interrupted save never loses the previous session.
+class Session
+{
+  public:
+    Session();
+    uint32_t sequence;
+    static uint32_t slot_size(uint32_t length);
+    void begin(FlashRegion *region, void *patterns, uint32_t length, int *row_offset, int *last_step, int *swing);
+    bool restore();
+    void mark_dirty();
+    void update();
+    void save_now();
+    bool is_saving();
+
+  private:
+    enum State
+    {
+      IDLE,
+      ERASING,
+      WRITING
+    };
+    FlashRegion *_region;
+    uint8_t *_patterns;
+    uint32_t _length;
+    int *_row_offset;
+    int *_last_step;
+    int *_swing;
+    State _state;
+    bool _is_dirty;
+    unsigned long _last_change;
+    int _active_slot;
+    int _slot;
+    uint32_t _position;
+    uint32_t _crc;
+    uint32_t slot_address(int slot);
+    void write_header();
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "Transport.h"
+
+uint32_t sixteenthNoteToTicks(uint16_t sixteenthNote)
+{
+  return sixteenthNote * 6;
+}
+
+// song position pointer is a 14 bit count of sixteenth notes, LSB first
+uint16_t songPositionToSixteenthNote(uint8_t lsb, uint8_t msb)
+{
+  return ((msb & 0x7F) << 7) | (lsb & 0x7F);
+}
+
+// whether the upbeat flag is set once every tick before this one was handled
+boolean isUpbeatAfter(uint32_t tick, int swing)
+{
+  int phase = (tick + 11) % 12;
+  return phase >= swing - (swing / 2) && phase < swing + ((12 - swing) / 2);
+}
+
+Transport::Transport()
+{
+  _tick = NULL;
+  _is_stopped = NULL;
+  _is_upbeat = NULL;
+  _swing = NULL;
+  _notes_off = NULL;
+}
+
+void Transport::begin(uint32_t *tick, boolean *is_stopped, boolean *is_upbeat, int *swing, void (*notes_off)())
+{
+  _tick = tick;
+  _is_stopped = is_stopped;
+  _is_upbeat = is_upbeat;
+  _swing = swing;
+  _notes_off = notes_off;
+}
+
+void Transport::relocate(uint32_t tick)
+{
+  _notes_off();
+  *_tick = tick;
+  *_is_upbeat = isUpbeatAfter(tick, *_swing);
+}
+
+int Transport::handle(midiEventPacket_t packet)
+{
+  if (packet.header == 3 && packet.byte1 == 0xF2)
+  { // song position pointer
+    Serial.println("position");
+    relocate(sixteenthNoteToTicks(songPositionToSixteenthNote(packet.byte2, packet.byte3)));
+    return TRANSPORT_POSITION;
+  }
+  if (packet.header != 15 || packet.byte1 < 0xF8)
+  {
+    return TRANSPORT_NONE;
+  }
+
+  switch (packet.byte1)
+  {
+  case 0xF8: // tick event - happens 24 times per quarter note
+    return *_is_stopped ? TRANSPORT_IGNORED : TRANSPORT_CLOCK;
+  case 0xFA:
+    Serial.println("start");
+    relocate(0);
+    *_is_stopped = false;
+    return TRANSPORT_START;
+  case 0xFB:
+    Serial.println("continue");
+    *_is_stopped = false;
+    return TRANSPORT_CONTINUE;
+  case 0xFC:
+    Serial.println("stop");
+    *_is_stopped = true;
+    _notes_off();
+    return TRANSPORT_STOP;
+  default:
+    return TRANSPORT_IGNORED;
+  }
+}
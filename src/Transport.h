@@ -0,0 +1,43 @@
+#ifndef Transport_h
+#define Transport_h
+
+#include "Arduino.h"
+#include <MIDIUSB.h>
+
+enum TransportEvent
+{
+  TRANSPORT_NONE, // not a transport message, left to the caller
+  TRANSPORT_CLOCK,
+  TRANSPORT_START,
+  TRANSPORT_CONTINUE,
+  TRANSPORT_STOP,
+  TRANSPORT_POSITION,
+  TRANSPORT_IGNORED // clock while stopped, active sensing and other real-time bytes
+};
+
+uint32_t sixteenthNoteToTicks(uint16_t sixteenthNote);
+uint16_t songPositionToSixteenthNote(uint8_t lsb, uint8_t msb);
+boolean isUpbeatAfter(uint32_t tick, int swing);
+
+// Start, continue, stop and song position pointer handling. Every playhead
+// is derived from tick, so moving to a new song position is just a matter
+// of setting it; notes_off is called first so none are left hanging. Clock
+// ticks are reported but tick itself is advanced by the caller once the
+// step has been played.
+class Transport
+{
+  public:
+    Transport();
+    void begin(uint32_t *tick, boolean *is_stopped, boolean *is_upbeat, int *swing, void (*notes_off)());
+    int handle(midiEventPacket_t packet);
+    void relocate(uint32_t tick);
+
+  private:
+    uint32_t *_tick;
+    boolean *_is_stopped;
+    boolean *_is_upbeat;
+    int *_swing;
+    void (*_notes_off)();
+};
+
+#endif
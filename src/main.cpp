@@ -5,16 +5,47 @@
 #include <Adafruit_ADXL343.h>
 #include <Adafruit_NeoTrellisM4.h>
 #include <MIDIUSB.h>
+#include <Adafruit_SPIFlash.h>
+#include <Audio.h>
 #include "Note.h"
+#include "FlashRegion.h"
+#include "Session.h"
+#include "History.h"
+#include "Capture.h"
+#include "Monitor.h"
+#include "Repeater.h"
+#include "DrumVoices.h"
+#include "MasterChain.h"
+#include "Transport.h"
 
 #define MIDI_CHANNEL 0 // default channel # is 0
 #define FIRST_MIDI_NOTE 36
+#define FIRST_SEND_CC 102 // one delay send level per row, CC 102 to 117 are undefined in MIDI
 #define NUMBER_OF_KEYS_ON_TRELLIS 32
 #define NUMBER_OF_COLUMNS_ON_TRELLIS 8
 #define NUMBER_OF_ROWS_ON_TRELLIS 4
 
 Adafruit_NeoTrellisM4 trellis = Adafruit_NeoTrellisM4();
 Adafruit_ADXL343 accel = Adafruit_ADXL343(123, &Wire1);
+Adafruit_FlashTransport_QSPI flashTransport;
+Adafruit_SPIFlash flash(&flashTransport);
+FlashRegion session_region;
+Session session;
+History history;
+FlashRegion capture_region;
+Capture capture;
+Monitor monitor;
+Repeater repeater;
+Transport transport;
+
+// synthesized drums on the DACs, rows trigger voices and feed the master chain
+DrumVoices drums;
+MasterChain master;
+AudioOutputAnalogStereo audio_out;
+AudioConnection dry_cord(drums, 0, master, 0);
+AudioConnection send_cord(drums, 1, master, 1);
+AudioConnection left_cord(master, 0, audio_out, 0);
+AudioConnection right_cord(master, 0, audio_out, 1);
 
 uint32_t tick = 0;
 
@@ -40,13 +71,18 @@ int row_offset = 12;
 int last_step = 8;
 int swing = 6;
 
-Note main_grid[NUMBER_OF_COLUMNS][NUMBER_OF_ROWS];
-Note shift_grid[NUMBER_OF_COLUMNS][NUMBER_OF_ROWS];
+// both grids live in one block so a session can be restored with a single read
+Note grids[2][NUMBER_OF_COLUMNS][NUMBER_OF_ROWS];
+Note (&main_grid)[NUMBER_OF_COLUMNS][NUMBER_OF_ROWS] = grids[0];
+Note (&shift_grid)[NUMBER_OF_COLUMNS][NUMBER_OF_ROWS] = grids[1];
 
 boolean pressed_keys[32];
 unsigned long when_key_was_pressed = 0;
 boolean combo_pressed = false;
 boolean is_upbeat = false;
+boolean is_stopped = false; // clock runs free until the host sends a stop
+unsigned long first_note_time = 0;
+CaptureState live_state; // set aside while a capture is replayed
 
 // modes
 boolean main_mode = true;
@@ -69,10 +105,18 @@ int swing_6_combo[] = {27, 7, 31};
 int swing_7_combo[] = {19, 7, 31};
 int swing_8_combo[] = {11, 7, 31};
 int swing_9_combo[] = {3, 7, 31};
+int undo_combo[] = {1, 7, 31};
+int redo_combo[] = {2, 7, 31};
 int manual_note_play_combo[] = {13, 29};
 int manual_note_record_combo[] = {5, 29};
 int manual_cc_combo[] = {4, 28};
 
+// note repeat, pressed on the right half while manual_note_play_combo is held
+int repeat_order_keys[] = {4, 12, 20, 28}; // all held pads, up, down, random
+int repeat_order_values[] = {REPEAT_ALL, REPEAT_UP, REPEAT_DOWN, REPEAT_RANDOM};
+int repeat_rate_keys[] = {6, 7, 14, 15, 22, 23, 30, 31}; // 1/8, 1/8T, 1/16, 1/16T, 1/32, 1/32T, 1/64, 1/64T
+int repeat_rate_values[] = {24, 16, 12, 8, 6, 4, 3, 2};   // half ticks
+
 int manual_cc_channels[] = {
     22,
     23,
@@ -117,24 +161,79 @@ float ofMap(float value, float inputMin, float inputMax, float outputMin, float
   return outVal;
 }
 
+// all MIDI output goes through these so a capture can record and check it
+void sendNoteOn(uint8_t pitch, uint8_t velocity)
+{
+  trellis.noteOn(pitch, velocity);
+  drums.trigger(pitch - FIRST_MIDI_NOTE, velocity);
+  capture.output(0x90, pitch, velocity);
+}
+
+void sendNoteOff(uint8_t pitch, uint8_t velocity)
+{
+  trellis.noteOff(pitch, velocity);
+  capture.output(0x80, pitch, velocity);
+}
+
+// the first manual CC channels also drive the master chain
+void controlAudio(uint8_t control, uint8_t value)
+{
+  for (int i = 0; i < NUMBER_OF_MASTER_CONTROLS; i++)
+  {
+    if (manual_cc_channels[i] == control)
+    {
+      master.control(i, value);
+    }
+  }
+  if (control >= FIRST_SEND_CC && control < FIRST_SEND_CC + DRUM_VOICES)
+  {
+    drums.set_send(control - FIRST_SEND_CC, value);
+  }
+}
+
+void sendControlChange(uint8_t control, uint8_t value)
+{
+  trellis.controlChange(control, value);
+  capture.output(0xB0, control, value);
+  controlAudio(control, value);
+}
+
 void play(Note note)
 {
   if (note.is_on)
   {
+    if (first_note_time == 0)
+    {
+      // millis() counts from reset, so this is boot-to-first-note
+      first_note_time = millis();
+      Serial.print("first note after ");
+      Serial.print(first_note_time);
+      Serial.println(" ms");
+    }
     if (note.is_accented)
     {
-      trellis.noteOn(note.midi, 127);
+      sendNoteOn(note.midi, 127);
     }
     else
     {
-      trellis.noteOn(note.midi, 96);
+      sendNoteOn(note.midi, 96);
     }
   }
 }
 
 void stop(Note note)
 {
-  trellis.noteOff(note.midi, 0);
+  sendNoteOff(note.midi, 0);
+}
+
+void allNotesOff()
+{
+  repeater.clear(); // its pending note-offs are covered below
+  for (int i = 0; i < NUMBER_OF_ROWS; i++)
+  {
+    sendNoteOff(FIRST_MIDI_NOTE + i, 0);
+  }
+  sendControlChange(123, 0); // all notes off
 }
 
 // Input a value 0 to 255 to get a color value.
@@ -155,11 +254,6 @@ uint32_t Wheel(byte WheelPos)
   return trellis.Color(WheelPos * 3, 255 - WheelPos * 3, 0);
 }
 
-uint32_t sixteenthNoteToTicks(uint8_t sixteenthNote)
-{
-  return sixteenthNote * 6;
-}
-
 uint32_t tickToEighthNote(uint32_t tick)
 {
   return tick / 12;
@@ -222,44 +316,274 @@ boolean isOnLeftHalfOfTrellis(int key)
   return key % NUMBER_OF_COLUMNS_ON_TRELLIS < NUMBER_OF_COLUMNS_ON_TRELLIS / 2;
 }
 
+// only for keys where isOnLeftHalfOfTrellis() holds
 int mapKeyToLeftHalfOfTrellis(int key)
 {
-  if (key % NUMBER_OF_COLUMNS_ON_TRELLIS == NUMBER_OF_COLUMNS_ON_TRELLIS / 2)
+  // https://www.desmos.com/calculator/xy1aphhomd
+  if (key < 8)
+  {
+    return (key * -4) + 15;
+  }
+  else if (key < 16)
+  {
+    return (key * -4) + 46;
+  }
+  else if (key < 24)
+  {
+    return (key * -4) + 77;
+  }
+  return (key * -4) + 108;
+}
+
+int mapKeyToRow(int key)
+{
+  return (mapKeyToLeftHalfOfTrellis(key) * -1) + 15;
+}
+
+int getPostitionFromTick(int tick, int last_step, int swing)
+{
+  return (int)((tick % (last_step * 12) / (float)swing) / 2);
+}
+
+void toggleNote(Note &note)
+{
+  uint8_t bits = History::bits(note);
+  note.toggle();
+  history.record(note, bits);
+  session.mark_dirty();
+}
+
+void toggleNoteAccent(Note &note)
+{
+  uint8_t bits = History::bits(note);
+  note.toggle_accent();
+  history.record(note, bits);
+  session.mark_dirty();
+}
+
+void turnNoteOn(Note &note)
+{
+  uint8_t bits = History::bits(note);
+  note.on();
+  history.record(note, bits);
+  session.mark_dirty();
+}
+
+void setParam(int param, int &value, int new_value)
+{
+  history.record_param(param, value, new_value);
+  value = new_value;
+  session.mark_dirty();
+}
+
+void playRepeats()
+{
+  uint8_t pad;
+  uint8_t velocity;
+  while (repeater.next_event(&pad, &velocity))
   {
-    // https://www.desmos.com/calculator/xy1aphhomd
-    if (key < 8)
+    if (velocity > 0)
     {
-      return (key * -4) + 15;
+      sendNoteOn(FIRST_MIDI_NOTE + pad, velocity);
     }
-    else if (key < 16)
+    else
     {
-      return (key * -4) + 46;
+      sendNoteOff(FIRST_MIDI_NOTE + pad, 0);
     }
-    else if (key < 24)
+  }
+}
+
+// Pressing the selected rate again turns note repeat off.
+boolean setRepeat(int key)
+{
+  for (int i = 0; i < (int)(sizeof(repeat_rate_keys) / sizeof(repeat_rate_keys[0])); i++)
+  {
+    if (key == repeat_rate_keys[i])
     {
-      return (key * -4) + 77;
+      repeater.rate = repeater.rate == repeat_rate_values[i] ? 0 : repeat_rate_values[i];
+      return true;
     }
-    else if (key < 32)
+  }
+  for (int i = 0; i < (int)(sizeof(repeat_order_keys) / sizeof(repeat_order_keys[0])); i++)
+  {
+    if (key == repeat_order_keys[i])
     {
-      return (key * -4) + 108;
+      repeater.order = repeat_order_values[i];
+      return true;
     }
   }
+  return false;
 }
 
-int mapKeyToRow(int key)
+// During a replay the live inputs are drained and ignored.
+midiEventPacket_t readMidi()
 {
-  return (mapKeyToLeftHalfOfTrellis(key) * -1) + 15;
+  midiEventPacket_t packet = MidiUSB.read();
+  if (capture.is_replaying())
+  {
+    capture.next_midi(&packet);
+  }
+  else
+  {
+    capture.log_midi(packet);
+  }
+  return packet;
 }
 
-int getPostitionFromTick(int tick, int last_step, int swing)
+boolean readKey(keypadEvent *e)
 {
-  return (int)((tick % (last_step * 12) / (float)swing) / 2);
+  if (capture.is_replaying())
+  {
+    while (trellis.available())
+    {
+      trellis.read();
+    }
+    return capture.next_key(e);
+  }
+  if (!trellis.available())
+  {
+    return false;
+  }
+  *e = trellis.read();
+  capture.log_key(*e);
+  return true;
+}
+
+void saveCaptureState(CaptureState *state)
+{
+  memset(state, 0, sizeof(CaptureState));
+  state->tick = tick;
+  state->row_offset = row_offset;
+  state->last_step = last_step;
+  state->swing = swing;
+  for (int i = 0; i < NUMBER_OF_KEYS_ON_TRELLIS; i++)
+  {
+    state->pressed_keys |= (uint32_t)pressed_keys[i] << i;
+  }
+  state->key_press_age = millis() - when_key_was_pressed;
+  state->repeat_held = repeater.held;
+  state->repeat_rate = repeater.rate;
+  state->repeat_order = repeater.order;
+  state->main_mode = main_mode;
+  state->manual_note_play_mode = manual_note_play_mode;
+  state->manual_note_record_mode = manual_note_record_mode;
+  state->manual_cc_mode = manual_cc_mode;
+  state->combo_pressed = combo_pressed;
+  state->is_stopped = is_stopped;
+  state->is_upbeat = is_upbeat;
+}
+
+void loadCaptureState(const CaptureState &state)
+{
+  tick = state.tick;
+  row_offset = state.row_offset;
+  last_step = state.last_step;
+  swing = state.swing;
+  for (int i = 0; i < NUMBER_OF_KEYS_ON_TRELLIS; i++)
+  {
+    pressed_keys[i] = (state.pressed_keys >> i) & 1;
+  }
+  when_key_was_pressed = millis() - state.key_press_age;
+  repeater.held = state.repeat_held;
+  repeater.rate = state.repeat_rate;
+  repeater.order = state.repeat_order;
+  main_mode = state.main_mode;
+  manual_note_play_mode = state.manual_note_play_mode;
+  manual_note_record_mode = state.manual_note_record_mode;
+  manual_cc_mode = state.manual_cc_mode;
+  combo_pressed = state.combo_pressed;
+  is_stopped = state.is_stopped;
+  is_upbeat = state.is_upbeat;
+}
+
+// The replay runs on the live globals, so everything it can touch is set
+// aside first: the session goes to flash, the rest into live_state and the
+// undo journal is suspended so replayed edits never mix with live ones.
+void startReplay()
+{
+  session.mark_dirty();
+  session.save_now();
+  allNotesOff();
+  saveCaptureState(&live_state);
+  CaptureState state;
+  if (!capture.start_replay(&state))
+  {
+    Serial.println("no capture to replay");
+    session.restore();
+    return;
+  }
+  history.suspend();
+  loadCaptureState(state);
+}
+
+void stopReplay()
+{
+  capture.stop();
+  allNotesOff();
+  session.restore();
+  loadCaptureState(live_state);
+  history.resume();
+}
+
+void printAudioUsage()
+{
+  // cycles available per block, the synth may use a quarter of them
+  uint32_t budget = F_CPU / AUDIO_SAMPLE_RATE_EXACT * AUDIO_BLOCK_SAMPLES / 4;
+  Serial.print("audio max cycles: voices ");
+  Serial.print(drums.max_cycles);
+  Serial.print(", master ");
+  Serial.print(master.max_cycles);
+  Serial.print(", budget ");
+  Serial.println(budget);
+}
+
+// single character commands over Serial
+void handleSerialCommand()
+{
+  if (!Serial.available())
+  {
+    return;
+  }
+  switch (Serial.read())
+  {
+  case 'c':
+    if (!capture.start_recording())
+    {
+      Serial.println("cannot capture");
+    }
+    break;
+  case 's':
+    if (capture.is_replaying())
+    {
+      stopReplay();
+    }
+    else
+    {
+      capture.stop();
+    }
+    break;
+  case 'r':
+    startReplay();
+    break;
+  case 'd':
+    capture.dump();
+    break;
+  case 'm':
+    monitor.report();
+    printAudioUsage();
+    break;
+  }
 }
 
 void setup()
 {
+  monitor.paint_stack();
+  monitor.begin(&repeater.dropped);
   Serial.begin(115200);
 
+  AudioMemory(12);
+  cycle_counter_begin();
+
   trellis.begin();
   trellis.setBrightness(80);
 
@@ -268,39 +592,69 @@ void setup()
   trellis.enableUSBMIDI(true);
   trellis.setUSBMIDIchannel(MIDI_CHANNEL);
 
-  for (int i = 0; i < NUMBER_OF_COLUMNS; i++)
+  unsigned long restore_start = micros();
+  boolean is_restored = false;
+  if (flash.begin())
   {
-    for (int j = 0; j < NUMBER_OF_ROWS; j++)
-    {
-      main_grid[i][j] = Note();
-      main_grid[i][j].set_note(getGridNote(FIRST_MIDI_NOTE, NUMBER_OF_ROWS, j));
-      main_grid[i][j].set_key(coordinatesToKey(i % 8, j % 4));
-    }
+    uint32_t session_size = Session::slot_size(sizeof(grids)) * 2;
+    session_region.begin(&flash, &flashTransport, flash.size() - session_size, session_size);
+    session.begin(&session_region, grids, sizeof(grids), &row_offset, &last_step, &swing);
+    capture_region.begin(&flash, &flashTransport, flash.size() - session_size - CAPTURE_FLASH_SIZE, CAPTURE_FLASH_SIZE);
+    capture.begin(&capture_region, grids, sizeof(grids), saveCaptureState);
+    is_restored = session.restore();
   }
-  for (int i = 0; i < NUMBER_OF_COLUMNS; i++)
+
+  transport.begin(&tick, &is_stopped, &is_upbeat, &swing, allNotesOff);
+  history.begin(&grids[0][0][0], sizeof(grids) / sizeof(Note), &row_offset, &last_step, &swing);
+
+  if (is_restored)
   {
-    for (int j = 0; j < NUMBER_OF_ROWS; j++)
+    Serial.print("restored session ");
+    Serial.print(session.sequence);
+    Serial.print(" in ");
+    Serial.print(micros() - restore_start);
+    Serial.println(" us");
+  }
+  else
+  {
+    for (int i = 0; i < NUMBER_OF_COLUMNS; i++)
+    {
+      for (int j = 0; j < NUMBER_OF_ROWS; j++)
+      {
+        main_grid[i][j] = Note();
+        main_grid[i][j].set_note(getGridNote(FIRST_MIDI_NOTE, NUMBER_OF_ROWS, j));
+        main_grid[i][j].set_key(coordinatesToKey(i % 8, j % 4));
+      }
+    }
+    for (int i = 0; i < NUMBER_OF_COLUMNS; i++)
     {
-      shift_grid[i][j] = Note();
-      shift_grid[i][j].set_note(getGridNote(FIRST_MIDI_NOTE, NUMBER_OF_ROWS, j));
-      shift_grid[i][j].set_key(coordinatesToKey(i % 8, j % 4));
+      for (int j = 0; j < NUMBER_OF_ROWS; j++)
+      {
+        shift_grid[i][j] = Note();
+        shift_grid[i][j].set_note(getGridNote(FIRST_MIDI_NOTE, NUMBER_OF_ROWS, j));
+        shift_grid[i][j].set_key(coordinatesToKey(i % 8, j % 4));
+      }
     }
   }
 }
 
 void loop()
 {
+  monitor.loop_start();
   trellis.tick();
 
-  midiEventPacket_t midi_in = MidiUSB.read();
+  midiEventPacket_t midi_in = readMidi();
 
-  if (midi_in.header == 3)
-  { // transport start
-    Serial.println("start");
-    tick = sixteenthNoteToTicks(midi_in.byte2); // syncs ticks to transport
-  }
-  else if (midi_in.header == 15)
+  int transport_event = transport.handle(midi_in);
+
+  if (transport_event == TRANSPORT_CLOCK)
   { // tick event - happens 24 times per quarter note
+    monitor.clock();
+    repeater.clock(tick, micros());
+    if (monitor.is_clock_steady())
+    {
+      master.set_clock_period(monitor.clock_period);
+    }
 
     // play and stop notes
     if (tick % 12 == 0)
@@ -309,7 +663,7 @@ void loop()
       {
         play(note);
       }
-      for (Note note : main_grid[(tickToEighthNote(tick) - 1) % last_step])
+      for (Note note : main_grid[(tickToEighthNote(tick) + last_step - 1) % last_step])
       {
         stop(note);
       }
@@ -320,7 +674,7 @@ void loop()
       {
         play(note);
       }
-      for (Note note : shift_grid[(tickToEighthNote(tick) - 1) % last_step])
+      for (Note note : shift_grid[(tickToEighthNote(tick) + last_step - 1) % last_step])
       {
         stop(note);
       }
@@ -399,9 +753,16 @@ void loop()
     }
     tick++;
   }
+  else if (transport_event == TRANSPORT_START || transport_event == TRANSPORT_CONTINUE)
+  { // the time spent stopped is not a clock period
+    monitor.restart();
+  }
+  else if (transport_event != TRANSPORT_NONE)
+  { // stop, position and other real-time bytes, already handled
+  }
   else if (midi_in.header == 11)
-  { // transport end
-    Serial.println("stop");
+  { // control change
+    controlAudio(midi_in.byte2, midi_in.byte3);
   }
   else if (midi_in.header == 9) {
     if (midi_in.byte2 == 0) {
@@ -409,6 +770,13 @@ void loop()
       is_upbeat = false;
     }
   }
+  else if (midi_in.header >= 4 && midi_in.header <= 7)
+  { // sysex
+    if (monitor.handle_sysex(midi_in))
+    {
+      monitor.send_sysex();
+    }
+  }
   else if (midi_in.header != 0)
   {
     Serial.println("message in");
@@ -442,6 +810,8 @@ void loop()
       trellis.setPixelColor(swing_7_combo[0], ref_color_4);
       trellis.setPixelColor(swing_8_combo[0], ref_color_4);
       trellis.setPixelColor(swing_9_combo[0], ref_color_4);
+      trellis.setPixelColor(undo_combo[0], ref_color_1);
+      trellis.setPixelColor(redo_combo[0], ref_color_1);
     }
     else if (checkCombo(manual_note_play_combo, sizeof(manual_note_play_combo) / sizeof(manual_note_play_combo[0]), pressed_keys))
     {
@@ -453,6 +823,14 @@ void loop()
           trellis.setPixelColor(i, ref_color_1);
         }
       }
+      for (int i = 0; i < (int)(sizeof(repeat_rate_keys) / sizeof(repeat_rate_keys[0])); i++)
+      {
+        trellis.setPixelColor(repeat_rate_keys[i], repeater.rate == repeat_rate_values[i] ? ref_color_2 : ref_color_4);
+      }
+      for (int i = 0; i < (int)(sizeof(repeat_order_keys) / sizeof(repeat_order_keys[0])); i++)
+      {
+        trellis.setPixelColor(repeat_order_keys[i], repeater.order == repeat_order_values[i] ? ref_color_2 : ref_color_4);
+      }
     }
     else if (checkCombo(manual_note_record_combo, sizeof(manual_note_record_combo) / sizeof(manual_note_record_combo[0]), pressed_keys))
     {
@@ -478,9 +856,9 @@ void loop()
     }
   }
 
-  while (trellis.available())
+  keypadEvent e;
+  while (readKey(&e))
   {
-    keypadEvent e = trellis.read();
     int key = e.bit.KEY;
     int col = e.bit.COL;
     int row = e.bit.ROW;
@@ -496,23 +874,37 @@ void loop()
         combo_pressed = true;
         if (manual_note_play_mode && isOnLeftHalfOfTrellis(key) && checkCombo(manual_note_play_combo, sizeof(manual_note_play_combo) / sizeof(manual_note_play_combo[0]), pressed_keys))
         {
-          trellis.noteOn(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 96);
+          if (repeater.is_enabled())
+          {
+            repeater.hold(mapKeyToLeftHalfOfTrellis(key));
+          }
+          else
+          {
+            sendNoteOn(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 96);
+          }
+        }
+        else if (manual_note_play_mode && checkCombo(manual_note_play_combo, sizeof(manual_note_play_combo) / sizeof(manual_note_play_combo[0]), pressed_keys) && setRepeat(key))
+        {
+          if (!repeater.is_enabled())
+          {
+            repeater.release_all();
+          }
         }
         else if (manual_note_record_mode && isOnLeftHalfOfTrellis(key) && checkCombo(manual_note_record_combo, sizeof(manual_note_record_combo) / sizeof(manual_note_record_combo[0]), pressed_keys))
         {
-          trellis.noteOn(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 96);
+          sendNoteOn(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 96);
           if (!is_upbeat)
           {
-            main_grid[getPostitionFromTick(tick, last_step, swing)][mapKeyToRow(key)].on();
+            turnNoteOn(main_grid[getPostitionFromTick(tick, last_step, swing)][mapKeyToRow(key)]);
           }
           else
           {
-            shift_grid[getPostitionFromTick(tick, last_step, swing)][mapKeyToRow(key)].on();
+            turnNoteOn(shift_grid[getPostitionFromTick(tick, last_step, swing)][mapKeyToRow(key)]);
           }
         }
         else if (manual_cc_mode && isOnLeftHalfOfTrellis(key) && checkCombo(manual_cc_combo, sizeof(manual_cc_combo) / sizeof(manual_cc_combo[0]), pressed_keys))
         {
-          trellis.controlChange(manual_cc_channels[mapKeyToLeftHalfOfTrellis(key)], 127);
+          sendControlChange(manual_cc_channels[mapKeyToLeftHalfOfTrellis(key)], 127);
         }
         else if (checkCombo(shift_combo, sizeof(shift_combo) / sizeof(shift_combo[0]), pressed_keys))
         {
@@ -541,7 +933,7 @@ void loop()
         {
           if (row_offset > 0)
           {
-            row_offset -= NUMBER_OF_ROWS_ON_TRELLIS;
+            setParam(PARAM_ROW_OFFSET, row_offset, row_offset - NUMBER_OF_ROWS_ON_TRELLIS);
             if (main_mode)
             {
               for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
@@ -568,7 +960,7 @@ void loop()
         {
           if (row_offset < 12)
           {
-            row_offset += NUMBER_OF_ROWS_ON_TRELLIS;
+            setParam(PARAM_ROW_OFFSET, row_offset, row_offset + NUMBER_OF_ROWS_ON_TRELLIS);
             if (main_mode)
             {
               for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
@@ -595,34 +987,35 @@ void loop()
         {
           if (last_step > NUMBER_OF_COLUMNS_ON_TRELLIS)
           {
-            last_step -= NUMBER_OF_COLUMNS_ON_TRELLIS;
+            setParam(PARAM_LAST_STEP, last_step, last_step - NUMBER_OF_COLUMNS_ON_TRELLIS);
           }
         }
         else if (checkCombo(last_step_right_combo, sizeof(last_step_right_combo) / sizeof(last_step_right_combo[0]), pressed_keys))
         {
           if (last_step < NUMBER_OF_COLUMNS)
           {
-            last_step += NUMBER_OF_COLUMNS_ON_TRELLIS;
+            setParam(PARAM_LAST_STEP, last_step, last_step + NUMBER_OF_COLUMNS_ON_TRELLIS);
           }
         }
         else if (checkCombo(swing_6_combo, sizeof(swing_6_combo) / sizeof(swing_6_combo[0]), pressed_keys))
         {
-          swing = 6;
+          setParam(PARAM_SWING, swing, 6);
         }
         else if (checkCombo(swing_7_combo, sizeof(swing_7_combo) / sizeof(swing_7_combo[0]), pressed_keys))
         {
-          swing = 7;
+          setParam(PARAM_SWING, swing, 7);
         }
         else if (checkCombo(swing_8_combo, sizeof(swing_8_combo) / sizeof(swing_8_combo[0]), pressed_keys))
         {
-          swing = 8;
+          setParam(PARAM_SWING, swing, 8);
         }
         else if (checkCombo(swing_9_combo, sizeof(swing_9_combo) / sizeof(swing_9_combo[0]), pressed_keys))
         {
-          swing = 9;
+          setParam(PARAM_SWING, swing, 9);
         }
         else if (checkCombo(clear_combo, sizeof(clear_combo) / sizeof(clear_combo[0]), pressed_keys))
         {
+          history.begin_group();
           for (int i = 0; i < NUMBER_OF_COLUMNS; i++)
           {
             for (int j = 0; j < NUMBER_OF_ROWS; j++)
@@ -637,6 +1030,62 @@ void loop()
               shift_grid[i][j].off();
             }
           }
+          history.end_group();
+          session.mark_dirty();
+        }
+        else if (checkCombo(undo_combo, sizeof(undo_combo) / sizeof(undo_combo[0]), pressed_keys))
+        {
+          if (history.undo())
+          {
+            session.mark_dirty();
+            if (main_mode)
+            {
+              for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
+              {
+                for (int j = 0; j < NUMBER_OF_ROWS_ON_TRELLIS; j++)
+                {
+                  trellis.setPixelColor(coordinatesToKey(i, j), main_grid[i + getColumnOffset(tick)][j + row_offset].is_on ? main_grid[i + getColumnOffset(tick)][j + row_offset].is_accented ? main_accent_color : main_color : off_color);
+                }
+              }
+            }
+            else
+            {
+              for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
+              {
+                for (int j = 0; j < NUMBER_OF_ROWS_ON_TRELLIS; j++)
+                {
+                  trellis.setPixelColor(coordinatesToKey(i, j), shift_grid[i + getColumnOffset(tick)][j + row_offset].is_on ? shift_grid[i + getColumnOffset(tick)][j + row_offset].is_accented ? shift_accent_color : shift_color : off_color);
+                }
+              }
+            }
+          }
+        }
+        else if (checkCombo(redo_combo, sizeof(redo_combo) / sizeof(redo_combo[0]), pressed_keys))
+        {
+          if (history.redo())
+          {
+            session.mark_dirty();
+            if (main_mode)
+            {
+              for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
+              {
+                for (int j = 0; j < NUMBER_OF_ROWS_ON_TRELLIS; j++)
+                {
+                  trellis.setPixelColor(coordinatesToKey(i, j), main_grid[i + getColumnOffset(tick)][j + row_offset].is_on ? main_grid[i + getColumnOffset(tick)][j + row_offset].is_accented ? main_accent_color : main_color : off_color);
+                }
+              }
+            }
+            else
+            {
+              for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
+              {
+                for (int j = 0; j < NUMBER_OF_ROWS_ON_TRELLIS; j++)
+                {
+                  trellis.setPixelColor(coordinatesToKey(i, j), shift_grid[i + getColumnOffset(tick)][j + row_offset].is_on ? shift_grid[i + getColumnOffset(tick)][j + row_offset].is_accented ? shift_accent_color : shift_color : off_color);
+                }
+              }
+            }
+          }
         }
       }
     }
@@ -649,12 +1098,12 @@ void loop()
         {
           if (millis() - when_key_was_pressed < HOLD_TIME)
           {
-            main_grid[col + getColumnOffset(tick)][row + row_offset].toggle();
+            toggleNote(main_grid[col + getColumnOffset(tick)][row + row_offset]);
             trellis.setPixelColor(key, main_grid[col][row + row_offset].is_on ? main_color : off_color);
           }
           else
           {
-            main_grid[col + getColumnOffset(tick)][row + row_offset].toggle_accent();
+            toggleNoteAccent(main_grid[col + getColumnOffset(tick)][row + row_offset]);
             trellis.setPixelColor(key, main_grid[col][row + row_offset].is_accented ? main_accent_color : off_color);
           }
         }
@@ -662,12 +1111,12 @@ void loop()
         {
           if (millis() - when_key_was_pressed < HOLD_TIME)
           {
-            shift_grid[col + getColumnOffset(tick)][row + row_offset].toggle();
+            toggleNote(shift_grid[col + getColumnOffset(tick)][row + row_offset]);
             trellis.setPixelColor(key, shift_grid[col][row + row_offset].is_on ? shift_color : off_color);
           }
           else
           {
-            shift_grid[col + getColumnOffset(tick)][row + row_offset].toggle_accent();
+            toggleNoteAccent(shift_grid[col + getColumnOffset(tick)][row + row_offset]);
             trellis.setPixelColor(key, shift_grid[col][row + row_offset].is_accented ? shift_accent_color : off_color);
           }
         }
@@ -681,6 +1130,7 @@ void loop()
       {
         if (numberOfButtonPressed(pressed_keys, sizeof(pressed_keys)) == 0)
         {
+          repeater.release_all();
           if (main_mode)
           {
             for (int i = 0; i < NUMBER_OF_COLUMNS_ON_TRELLIS; i++)
@@ -705,21 +1155,43 @@ void loop()
         }
         else if (manual_note_play_mode && isOnLeftHalfOfTrellis(key))
         {
-          trellis.noteOff(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 0);
+          repeater.release(mapKeyToLeftHalfOfTrellis(key));
+          sendNoteOff(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 0);
         }
         else if (manual_note_record_mode && isOnLeftHalfOfTrellis(key))
         {
-          trellis.noteOff(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 0);
+          sendNoteOff(FIRST_MIDI_NOTE + mapKeyToLeftHalfOfTrellis(key), 0);
         }
         else if (manual_cc_mode && isOnLeftHalfOfTrellis(key))
         {
-          trellis.controlChange(manual_cc_channels[mapKeyToLeftHalfOfTrellis(key)], 0);
+          sendControlChange(manual_cc_channels[mapKeyToLeftHalfOfTrellis(key)], 0);
         }
       }
     }
   }
 
+  repeater.update(micros());
+  playRepeats();
+
   trellis.sendMIDI(); // send any pending MIDI messages
 
+  if (capture.is_replaying())
+  {
+    capture.update();
+    if (!capture.is_replaying())
+    {
+      stopReplay();
+    }
+  }
+  else
+  {
+    capture.update();
+    session.update();
+  }
+
+  monitor.loop_end();
+
+  handleSerialCommand();
+
   delay(1);
 }
@@ -0,0 +1,70 @@
+// Streams shared by the audio test and the offline renderer, to feed the
+// firmware's streams and take what they transmit.
+#ifndef audio_h
+#define audio_h
+
+#include "DrumVoices.h"
+#include "MasterChain.h"
+
+// Transmits the next block of each input, nothing once one runs out.
+class Source : public AudioStream
+{
+  public:
+    Source() : AudioStream(0, NULL), position(0) {}
+    std::vector<int16_t> samples[2];
+    size_t position;
+    void update()
+    {
+      for (int output = 0; output < 2; output++)
+      {
+        if (position + AUDIO_BLOCK_SAMPLES > samples[output].size())
+        {
+          continue;
+        }
+        audio_block_t *block = allocate();
+        if (block)
+        {
+          memcpy(block->data, &samples[output][position], sizeof(block->data));
+          transmit(block, output);
+          release(block);
+        }
+      }
+      position += AUDIO_BLOCK_SAMPLES;
+    }
+};
+
+// Keeps every block it receives, a missing block is kept as silence.
+class Sink : public AudioStream
+{
+  public:
+    Sink() : AudioStream(2, inputQueueArray) {}
+    std::vector<int16_t> samples[2];
+    bool has_block[2];
+    void update()
+    {
+      for (int input = 0; input < 2; input++)
+      {
+        audio_block_t *block = receiveReadOnly(input);
+        has_block[input] = block != NULL;
+        if (block)
+        {
+          samples[input].insert(samples[input].end(), block->data, block->data + AUDIO_BLOCK_SAMPLES);
+          release(block);
+        }
+        else
+        {
+          samples[input].resize(samples[input].size() + AUDIO_BLOCK_SAMPLES);
+        }
+      }
+    }
+    void clear()
+    {
+      samples[0].clear();
+      samples[1].clear();
+    }
+
+  private:
+    audio_block_t *inputQueueArray[2];
+};
+
+#endif
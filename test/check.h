@@ -0,0 +1,40 @@
+// Minimal assertions for the host tests: failures are counted and printed,
+// main() returns check_report() so make stops on the first failing binary.
+#ifndef check_h
+#define check_h
+
+#include <stdio.h>
+
+static int check_count = 0;
+static int check_failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(expected, actual) check_equal((long)(expected), (long)(actual), #actual, __FILE__, __LINE__)
+
+static inline void check(bool condition, const char *text, const char *file, int line)
+{
+  check_count++;
+  if (!condition)
+  {
+    check_failures++;
+    printf("%s:%d: failed: %s\n", file, line, text);
+  }
+}
+
+static inline void check_equal(long expected, long actual, const char *text, const char *file, int line)
+{
+  check_count++;
+  if (expected != actual)
+  {
+    check_failures++;
+    printf("%s:%d: %s is %ld, expected %ld\n", file, line, text, actual, expected);
+  }
+}
+
+static inline int check_report(const char *name)
+{
+  printf("%s: %d checks, %d failed\n", name, check_count, check_failures);
+  return check_failures == 0 ? 0 : 1;
+}
+
+#endif
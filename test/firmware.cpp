@@ -0,0 +1,115 @@
+#include "firmware.h"
+#include <sstream>
+
+static unsigned long next_clock = 0;
+static uint64_t audio_blocks = 0;
+
+// one pass of loop(), then the audio blocks that fell due meanwhile, as the
+// audio interrupt would have run them
+static void pass()
+{
+  loop();
+  while (host_micros >= audio_blocks * AUDIO_BLOCK_SAMPLES * 1000000 / (uint32_t)AUDIO_SAMPLE_RATE_EXACT)
+  {
+    AudioStream::update_all();
+    audio_blocks++;
+  }
+}
+
+void sendRealTime(uint8_t status)
+{
+  midiEventPacket_t packet = {0x0F, status, 0, 0};
+  MidiUSB.input.push_back(packet);
+}
+
+// runs loop() for ms passes, queueing a MIDI clock every clock_period us
+void runFor(unsigned long ms, unsigned long clock_period)
+{
+  if (clock_period > 0 && (long)(host_micros - next_clock) > (long)clock_period)
+  {
+    next_clock = host_micros;
+  }
+  for (unsigned long i = 0; i < ms; i++)
+  {
+    if (clock_period > 0 && (long)(host_micros - next_clock) >= 0)
+    {
+      sendRealTime(0xF8);
+      next_clock += clock_period;
+    }
+    pass();
+  }
+}
+
+bool runUntilOutput(const char *text, unsigned long timeout_ms)
+{
+  for (unsigned long i = 0; i < timeout_ms; i++)
+  {
+    if (Serial.output.find(text) != std::string::npos)
+    {
+      return true;
+    }
+    pass();
+  }
+  return Serial.output.find(text) != std::string::npos;
+}
+
+static bool isHexLine(const std::string &line)
+{
+  if (line.empty() || line.size() % 2 != 0 || line.size() > 64)
+  {
+    return false;
+  }
+  for (char c : line)
+  {
+    if (!isxdigit((unsigned char)c))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Takes the output of the 'd' command, with anything else the firmware
+// printed around it, and programs it back into the capture region. The
+// dump is the run of full 32 byte lines ending in a shorter one.
+bool loadCapture(const std::string &dump)
+{
+  std::istringstream lines(dump);
+  std::string line;
+  std::vector<uint8_t> bytes;
+  bool is_inside = false;
+  while (std::getline(lines, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.erase(line.size() - 1);
+    }
+    if (!isHexLine(line) || (!is_inside && line.size() != 64))
+    {
+      if (is_inside)
+      {
+        break;
+      }
+      continue;
+    }
+    is_inside = true;
+    for (size_t i = 0; i < line.size(); i += 2)
+    {
+      bytes.push_back(strtoul(line.substr(i, 2).c_str(), NULL, 16));
+    }
+    if (line.size() < 64)
+    {
+      break;
+    }
+  }
+  if (bytes.empty() || bytes.size() > capture_region.size)
+  {
+    return false;
+  }
+  for (uint32_t offset = 0; offset < bytes.size(); offset += FLASH_SECTOR_SIZE)
+  {
+    capture_region.start_erase(offset);
+  }
+  capture_region.write(0, &bytes[0], bytes.size());
+  return true;
+}
@@ -0,0 +1,35 @@
+// Runs the real firmware (src/main.cpp) on the host against the stubs in
+// stubs/. Time only moves in loop(), which ends with delay(1), so every
+// pass is one simulated millisecond. The audio streams run once per block
+// period in between.
+#ifndef firmware_h
+#define firmware_h
+
+#include <Adafruit_NeoTrellisM4.h>
+#include <MIDIUSB.h>
+#include <string>
+#include "FlashRegion.h"
+#include "MasterChain.h"
+#include "Monitor.h"
+#include "Note.h"
+
+void setup();
+void loop();
+
+extern Adafruit_NeoTrellisM4 trellis;
+extern FlashRegion capture_region;
+extern Monitor monitor;
+extern MasterChain master;
+extern Note grids[2][32][16];
+extern uint32_t tick;
+extern boolean pressed_keys[32];
+extern boolean main_mode;
+extern boolean combo_pressed;
+extern boolean is_stopped;
+
+void sendRealTime(uint8_t status);
+void runFor(unsigned long ms, unsigned long clock_period = 0);
+bool runUntilOutput(const char *text, unsigned long timeout_ms);
+bool loadCapture(const std::string &dump);
+
+#endif
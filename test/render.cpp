@@ -0,0 +1,168 @@
+// Renders a drum pattern through the drum voices and the master chain
+// offline, the same streams the firmware runs, and times both per block:
+//
+//   make -C test bench
+//
+// writes build/render.wav. Host times only compare changes against each
+// other; the cycles against the real budget come from 'm' on the device.
+#include <stdio.h>
+#include <chrono> // before the stub Arduino.h defines min and max
+#include "audio.h"
+
+#define BPM 120
+#define BARS 8
+#define RENDER_FILE "build/render.wav"
+
+// one bar of sixteenths per voice, bit 0 is the first step
+struct Track
+{
+  int voice;
+  uint16_t steps;
+};
+
+static const Track pattern[] = {
+    {0, 0x1111},  // kick on the quarters
+    {2, 0x1010},  // snare on two and four
+    {6, 0x5555},  // closed hat on the eighths
+    {10, 0x4000}, // open hat before the bar
+    {9, 0x0200},  // low tom
+    {12, 0x0800}, // high mid tom
+};
+
+typedef std::chrono::steady_clock Clock;
+
+struct Timing
+{
+  double total;
+  double worst;
+  int blocks;
+  Timing() : total(0), worst(0), blocks(0) {}
+  void add(Clock::duration duration)
+  {
+    double us = std::chrono::duration<double, std::micro>(duration).count();
+    total += us;
+    worst = max(worst, us);
+    blocks++;
+  }
+  void print(const char *name)
+  {
+    printf("%-8s mean %6.2f us, max %6.2f us\n", name, total / blocks, worst);
+  }
+};
+
+static void writeLittleEndian(FILE *file, uint32_t value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+  {
+    fputc((value >> (8 * i)) & 0xFF, file);
+  }
+}
+
+static bool writeWav(const char *path, const std::vector<int16_t> &samples)
+{
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  uint32_t rate = (uint32_t)AUDIO_SAMPLE_RATE_EXACT;
+  uint32_t length = samples.size() * 2;
+  fputs("RIFF", file);
+  writeLittleEndian(file, 36 + length, 4);
+  fputs("WAVEfmt ", file);
+  writeLittleEndian(file, 16, 4);
+  writeLittleEndian(file, 1, 2); // PCM
+  writeLittleEndian(file, 1, 2); // mono
+  writeLittleEndian(file, rate, 4);
+  writeLittleEndian(file, rate * 2, 4);
+  writeLittleEndian(file, 2, 2);
+  writeLittleEndian(file, 16, 2);
+  fputs("data", file);
+  writeLittleEndian(file, length, 4);
+  for (int16_t sample : samples)
+  {
+    writeLittleEndian(file, (uint16_t)sample, 2);
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  static DrumVoices drums;
+  static MasterChain master;
+  static Sink sink;
+  AudioConnection dry_cord(drums, 0, master, 0);
+  AudioConnection send_cord(drums, 1, master, 1);
+  AudioConnection out_cord(master, 0, sink, 0);
+  master.control(MASTER_COMPRESSOR, 64);
+  master.control(MASTER_CRUSH, 16);
+
+  double tick_period = 60000000.0 / BPM / 24;
+  double samples_per_step = AUDIO_SAMPLE_RATE_EXACT * tick_period * 6 / 1000000;
+  int steps = BARS * 16;
+  int blocks = (int)(steps * samples_per_step / AUDIO_BLOCK_SAMPLES) + 1;
+
+  Timing drum_timing;
+  Timing master_timing;
+  int step = 0;
+
+  for (int block = 0; block < blocks; block++)
+  {
+    // the clock as the monitor smooths it, a few hundred us either way
+    master.set_clock_period(tick_period + (block * 7919) % 400 - 200);
+    while (step < steps && step * samples_per_step < (block + 1) * AUDIO_BLOCK_SAMPLES)
+    {
+      for (const Track &track : pattern)
+      {
+        if (track.steps & (1 << (step % 16)))
+        {
+          drums.trigger(track.voice, step % 4 == 0 ? 127 : 90);
+        }
+      }
+      step++;
+    }
+
+    Clock::time_point start = Clock::now();
+    drums.update();
+    Clock::time_point middle = Clock::now();
+    master.update(); // no block from the drums reads as silence
+    Clock::time_point end = Clock::now();
+    sink.update();
+    drum_timing.add(middle - start);
+    master_timing.add(end - middle);
+  }
+  std::vector<int16_t> output = sink.samples[0];
+
+  // worst case for the synth, every voice sounding at once
+  Timing all_timing;
+  for (int block = 0; block < 2000; block++)
+  {
+    if (block % 100 == 0)
+    {
+      for (int voice = 0; voice < DRUM_VOICES; voice++)
+      {
+        drums.trigger(voice, 127);
+      }
+    }
+    Clock::time_point start = Clock::now();
+    drums.update();
+    all_timing.add(Clock::now() - start);
+    master.update();
+  }
+
+  double block_period = AUDIO_BLOCK_SAMPLES * 1000000.0 / AUDIO_SAMPLE_RATE_EXACT;
+  printf("block period %.0f us, %d samples at %.0f Hz\n", block_period, AUDIO_BLOCK_SAMPLES, AUDIO_SAMPLE_RATE_EXACT);
+  drum_timing.print("drums");
+  all_timing.print("all 16");
+  master_timing.print("master");
+
+  const char *path = argc > 1 ? argv[1] : RENDER_FILE;
+  if (!writeWav(path, output))
+  {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  printf("wrote %s, %.1f s\n", path, output.size() / AUDIO_SAMPLE_RATE_EXACT);
+  return 0;
+}
@@ -0,0 +1,39 @@
+// Replays a capture pulled off the device with the 'd' command against the
+// firmware built for the host, in simulated time:
+//
+//   make -C test build/replay && test/build/replay capture.txt
+//
+// Exits non-zero when the outputs differ from the recording.
+#include "firmware.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s capture.txt\n", argv[0]);
+    return 2;
+  }
+  std::ifstream file(argv[1]);
+  std::stringstream dump;
+  dump << file.rdbuf();
+
+  setup();
+  if (!loadCapture(dump.str()))
+  {
+    fprintf(stderr, "%s: no capture found\n", argv[1]);
+    return 2;
+  }
+
+  Serial.output.clear();
+  Serial.input += 'r';
+  // a capture fills at most 1 MB, well under an hour of records
+  bool is_done = runUntilOutput("mean drift us: ", 3600UL * 1000);
+  runFor(1);
+
+  size_t start = Serial.output.find("replay ");
+  fputs(start == std::string::npos ? Serial.output.c_str() : Serial.output.c_str() + start, stdout);
+  return is_done && Serial.output.find("replay matches") != std::string::npos ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+#ifndef Adafruit_ADXL343_h
+#define Adafruit_ADXL343_h
+
+#include "Arduino.h"
+#include "Wire.h"
+
+class Adafruit_ADXL343
+{
+  public:
+    Adafruit_ADXL343(int32_t sensor_id, TwoWire *wire) {}
+    bool begin() { return false; }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef Adafruit_Keypad_h
+#define Adafruit_Keypad_h
+
+#include <stdint.h>
+
+#define KEY_JUST_RELEASED (0)
+#define KEY_JUST_PRESSED (1)
+#define KEY_PRESSED (2)
+#define KEY_RELEASED (3)
+
+union keypadEvent
+{
+  struct
+  {
+    uint8_t KEY : 8;
+    uint8_t EVENT : 8;
+    uint8_t ROW : 8;
+    uint8_t COL : 8;
+  } bit;
+  uint32_t reg;
+};
+
+#endif
@@ -0,0 +1,41 @@
+// Host stand-in for the Trellis: key events are queued by the test, notes
+// and control changes that go out are logged.
+#ifndef Adafruit_NeoTrellisM4_h
+#define Adafruit_NeoTrellisM4_h
+
+#include "Arduino.h"
+#include "Adafruit_Keypad.h"
+#include "Wire.h"
+#include <deque>
+#include <vector>
+
+struct TrellisOutput
+{
+  uint8_t status;
+  uint8_t data1;
+  uint8_t data2;
+};
+
+class Adafruit_NeoTrellisM4
+{
+  public:
+    std::deque<keypadEvent> keys;
+    std::vector<TrellisOutput> sent;
+    uint32_t pixels[32];
+    void begin() {}
+    void setBrightness(uint8_t brightness) {}
+    void enableUSBMIDI(bool is_enabled) {}
+    void setUSBMIDIchannel(uint8_t channel) {}
+    void tick() {}
+    bool available() { return !keys.empty(); }
+    keypadEvent read();
+    void press(int key, uint8_t event);
+    void noteOn(uint8_t pitch, uint8_t velocity);
+    void noteOff(uint8_t pitch, uint8_t velocity);
+    void controlChange(uint8_t control, uint8_t value);
+    void sendMIDI() {}
+    void setPixelColor(uint32_t pixel, uint32_t color);
+    uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+};
+
+#endif
@@ -0,0 +1,46 @@
+// Host stand-in for the QSPI flash, a RAM image with NOR semantics: erase
+// sets a sector to 0xFF and programming can only clear bits. Operations
+// finish at once, so the chip never reads busy.
+#ifndef Adafruit_SPIFlash_h
+#define Adafruit_SPIFlash_h
+
+#include "Arduino.h"
+#include <vector>
+
+#define HOST_FLASH_SIZE (2 * 1024 * 1024UL)
+
+enum
+{
+  SFLASH_CMD_WRITE_ENABLE = 0x06,
+  SFLASH_CMD_ERASE_SECTOR = 0x20
+};
+
+class Adafruit_FlashTransport
+{
+  public:
+    std::vector<uint8_t> image;
+    Adafruit_FlashTransport() : image(HOST_FLASH_SIZE, 0xFF) {}
+    bool runCommand(uint8_t command) { return true; }
+    bool eraseCommand(uint8_t command, uint32_t address);
+};
+
+class Adafruit_FlashTransport_QSPI : public Adafruit_FlashTransport
+{
+};
+
+class Adafruit_SPIFlash
+{
+  public:
+    Adafruit_SPIFlash(Adafruit_FlashTransport *transport) : _transport(transport) {}
+    bool begin() { return true; }
+    uint32_t size() { return _transport->image.size(); }
+    uint8_t readStatus() { return 0; }
+    void waitUntilReady() {}
+    uint32_t readBuffer(uint32_t address, uint8_t *buffer, uint32_t length);
+    uint32_t writeBuffer(uint32_t address, uint8_t const *buffer, uint32_t length);
+
+  private:
+    Adafruit_FlashTransport *_transport;
+};
+
+#endif
@@ -0,0 +1,3 @@
+#ifndef Adafruit_Sensor_h
+#define Adafruit_Sensor_h
+#endif
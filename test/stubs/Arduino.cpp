@@ -0,0 +1,113 @@
+#include "Arduino.h"
+#include <stdio.h>
+
+unsigned long host_micros = 0;
+HostSerial Serial;
+
+unsigned long millis()
+{
+  return host_micros / 1000;
+}
+
+unsigned long micros()
+{
+  return host_micros;
+}
+
+void delay(unsigned long ms)
+{
+  host_micros += ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  host_micros += us;
+}
+
+long random(long howbig)
+{
+  return howbig > 0 ? rand() % howbig : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+  return howsmall + random(howbig - howsmall);
+}
+
+HostSerial::HostSerial()
+{
+  is_echoing = getenv("HOST_SERIAL_ECHO") != NULL;
+}
+
+void HostSerial::begin(long baud)
+{
+}
+
+HostSerial::operator bool()
+{
+  return true;
+}
+
+int HostSerial::available()
+{
+  return input.size();
+}
+
+int HostSerial::read()
+{
+  if (input.empty())
+  {
+    return -1;
+  }
+  int c = (uint8_t)input[0];
+  input.erase(0, 1);
+  return c;
+}
+
+void HostSerial::print(const char *text)
+{
+  output += text;
+  if (is_echoing)
+  {
+    fputs(text, stdout);
+  }
+}
+
+void HostSerial::print(const std::string &text)
+{
+  print(text.c_str());
+}
+
+void HostSerial::print(char c)
+{
+  char text[2] = {c, 0};
+  print(text);
+}
+
+void HostSerial::print(long value, int base)
+{
+  char text[24];
+  if (base == HEX)
+  {
+    snprintf(text, sizeof(text), "%lX", value);
+  }
+  else
+  {
+    snprintf(text, sizeof(text), "%ld", value);
+  }
+  print(text);
+}
+
+void HostSerial::print(unsigned long value, int base)
+{
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lX" : "%lu", value);
+  print(text);
+}
+
+void HostSerial::print(double value, int digits)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  print(text);
+}
@@ -0,0 +1,68 @@
+// Host stand-in for the Arduino core. Time only moves when a test moves it,
+// and everything printed to Serial is kept so it can be inspected.
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+// the standard containers the stubs use, pulled in before min/max exist
+#include <deque>
+#include <vector>
+#include <sstream>
+#include <fstream>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HEX 16
+#define DEC 10
+#define F_CPU 120000000L
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+extern unsigned long host_micros;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+
+class HostSerial
+{
+  public:
+    std::string output;
+    std::string input;
+    boolean is_echoing;
+
+    HostSerial();
+    void begin(long baud);
+    operator bool();
+    int available();
+    int read();
+    void print(const char *text);
+    void print(const std::string &text);
+    void print(char c);
+    void print(long value, int base = DEC);
+    void print(unsigned long value, int base = DEC);
+    void print(int value, int base = DEC) { print((long)value, base); }
+    void print(unsigned int value, int base = DEC) { print((unsigned long)value, base); }
+    void print(unsigned char value, int base = DEC) { print((unsigned long)value, base); }
+    void print(double value, int digits = 2);
+    void println() { print("\n"); }
+    template <class T> void println(T value) { print(value); println(); }
+    template <class T> void println(T value, int format) { print(value, format); println(); }
+    void flush() {}
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,139 @@
+#include "AudioStream.h"
+
+static audio_block_t pool[HOST_AUDIO_BLOCKS];
+
+AudioStream *AudioStream::_first = NULL;
+
+AudioStream::AudioStream(unsigned char inputs, audio_block_t **queue)
+{
+  _inputs = inputs;
+  _queue = queue;
+  for (int i = 0; i < inputs; i++)
+  {
+    _queue[i] = NULL;
+  }
+  _destinations = NULL;
+  _next = NULL;
+  AudioStream **link = &_first;
+  while (*link)
+  {
+    link = &(*link)->_next;
+  }
+  *link = this;
+}
+
+AudioStream::~AudioStream()
+{
+  for (AudioStream **link = &_first; *link; link = &(*link)->_next)
+  {
+    if (*link == this)
+    {
+      *link = _next;
+      break;
+    }
+  }
+  for (int i = 0; i < _inputs; i++)
+  {
+    release(_queue[i]);
+  }
+}
+
+void AudioStream::update_all()
+{
+  for (AudioStream *stream = _first; stream; stream = stream->_next)
+  {
+    stream->update();
+  }
+}
+
+int AudioStream::blocks_in_use()
+{
+  int count = 0;
+  for (int i = 0; i < HOST_AUDIO_BLOCKS; i++)
+  {
+    count += pool[i].ref_count > 0;
+  }
+  return count;
+}
+
+audio_block_t *AudioStream::allocate()
+{
+  for (int i = 0; i < HOST_AUDIO_BLOCKS; i++)
+  {
+    if (pool[i].ref_count == 0)
+    {
+      pool[i].ref_count = 1;
+      pool[i].memory_pool_index = i;
+      return &pool[i];
+    }
+  }
+  return NULL;
+}
+
+// a block still queued from the last update is kept, as the library does
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+  for (AudioConnection *cord = _destinations; cord; cord = cord->_next)
+  {
+    audio_block_t *&queued = cord->_destination._queue[cord->_destination_input];
+    if (cord->_source_output == index && queued == NULL)
+    {
+      block->ref_count++;
+      queued = block;
+    }
+  }
+}
+
+audio_block_t *AudioStream::receiveReadOnly(unsigned int index)
+{
+  if (index >= _inputs)
+  {
+    return NULL;
+  }
+  audio_block_t *block = _queue[index];
+  _queue[index] = NULL;
+  return block;
+}
+
+audio_block_t *AudioStream::receiveWritable(unsigned int index)
+{
+  audio_block_t *block = receiveReadOnly(index);
+  if (block && block->ref_count > 1)
+  {
+    audio_block_t *copy = allocate();
+    if (copy)
+    {
+      memcpy(copy->data, block->data, sizeof(copy->data));
+    }
+    release(block);
+    block = copy;
+  }
+  return block;
+}
+
+void AudioStream::release(audio_block_t *block)
+{
+  if (block && block->ref_count > 0)
+  {
+    block->ref_count--;
+  }
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char source_output, AudioStream &destination, unsigned char destination_input)
+    : _source(source), _source_output(source_output), _destination(destination), _destination_input(destination_input)
+{
+  _next = source._destinations;
+  source._destinations = this;
+}
+
+AudioConnection::~AudioConnection()
+{
+  for (AudioConnection **link = &_source._destinations; *link; link = &(*link)->_next)
+  {
+    if (*link == this)
+    {
+      *link = _next;
+      break;
+    }
+  }
+}
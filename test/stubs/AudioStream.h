@@ -0,0 +1,64 @@
+// Host stand-in for the audio library core: a block pool with reference
+// counts, connections that queue a transmitted block on every input it
+// feeds, and update_all() to run every stream once in the order they were
+// constructed, the way the audio interrupt does.
+#ifndef AudioStream_h
+#define AudioStream_h
+
+#include "Arduino.h"
+
+#define AUDIO_BLOCK_SAMPLES 128
+#define AUDIO_SAMPLE_RATE_EXACT 44100.0f
+#define HOST_AUDIO_BLOCKS 16
+
+typedef struct audio_block_struct
+{
+  uint8_t ref_count;
+  uint8_t reserved1;
+  uint16_t memory_pool_index;
+  int16_t data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioConnection;
+
+class AudioStream
+{
+  public:
+    AudioStream(unsigned char inputs, audio_block_t **queue);
+    virtual ~AudioStream();
+    virtual void update(void) = 0;
+    static void update_all();
+    static int blocks_in_use();
+
+  protected:
+    static audio_block_t *allocate();
+    void transmit(audio_block_t *block, unsigned char index = 0);
+    audio_block_t *receiveReadOnly(unsigned int index = 0);
+    audio_block_t *receiveWritable(unsigned int index = 0);
+    static void release(audio_block_t *block);
+
+  private:
+    friend class AudioConnection;
+    unsigned char _inputs;
+    audio_block_t **_queue;
+    AudioStream *_next;
+    AudioConnection *_destinations;
+    static AudioStream *_first;
+};
+
+class AudioConnection
+{
+  public:
+    AudioConnection(AudioStream &source, unsigned char source_output, AudioStream &destination, unsigned char destination_input);
+    ~AudioConnection();
+
+  private:
+    friend class AudioStream;
+    AudioStream &_source;
+    unsigned char _source_output;
+    AudioStream &_destination;
+    unsigned char _destination_input;
+    AudioConnection *_next;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "Adafruit_NeoTrellisM4.h"
+#include "Adafruit_SPIFlash.h"
+#include "MIDIUSB.h"
+
+TwoWire Wire1;
+MIDI_ MidiUSB;
+
+keypadEvent Adafruit_NeoTrellisM4::read()
+{
+  keypadEvent e = keys.front();
+  keys.pop_front();
+  return e;
+}
+
+void Adafruit_NeoTrellisM4::press(int key, uint8_t event)
+{
+  keypadEvent e;
+  e.reg = 0;
+  e.bit.KEY = key;
+  e.bit.EVENT = event;
+  e.bit.ROW = key / 8;
+  e.bit.COL = key % 8;
+  keys.push_back(e);
+}
+
+void Adafruit_NeoTrellisM4::noteOn(uint8_t pitch, uint8_t velocity)
+{
+  TrellisOutput output = {0x90, pitch, velocity};
+  sent.push_back(output);
+}
+
+void Adafruit_NeoTrellisM4::noteOff(uint8_t pitch, uint8_t velocity)
+{
+  TrellisOutput output = {0x80, pitch, velocity};
+  sent.push_back(output);
+}
+
+void Adafruit_NeoTrellisM4::controlChange(uint8_t control, uint8_t value)
+{
+  TrellisOutput output = {0xB0, control, value};
+  sent.push_back(output);
+}
+
+void Adafruit_NeoTrellisM4::setPixelColor(uint32_t pixel, uint32_t color)
+{
+  if (pixel < 32)
+  {
+    pixels[pixel] = color;
+  }
+}
+
+midiEventPacket_t MIDI_::read()
+{
+  midiEventPacket_t packet = {0, 0, 0, 0};
+  if (!input.empty())
+  {
+    packet = input.front();
+    input.pop_front();
+  }
+  return packet;
+}
+
+bool Adafruit_FlashTransport::eraseCommand(uint8_t command, uint32_t address)
+{
+  uint32_t sector = address & ~(uint32_t)(4096 - 1);
+  if (sector + 4096 <= image.size())
+  {
+    memset(&image[sector], 0xFF, 4096);
+  }
+  return true;
+}
+
+uint32_t Adafruit_SPIFlash::readBuffer(uint32_t address, uint8_t *buffer, uint32_t length)
+{
+  memcpy(buffer, &_transport->image[address], length);
+  return length;
+}
+
+uint32_t Adafruit_SPIFlash::writeBuffer(uint32_t address, uint8_t const *buffer, uint32_t length)
+{
+  for (uint32_t i = 0; i < length; i++)
+  {
+    _transport->image[address + i] &= buffer[i];
+  }
+  return length;
+}
@@ -0,0 +1,29 @@
+#ifndef MIDIUSB_h
+#define MIDIUSB_h
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+typedef struct
+{
+  uint8_t header;
+  uint8_t byte1;
+  uint8_t byte2;
+  uint8_t byte3;
+} midiEventPacket_t;
+
+// incoming packets are queued by the test, outgoing ones logged
+class MIDI_
+{
+  public:
+    std::deque<midiEventPacket_t> input;
+    std::vector<midiEventPacket_t> sent;
+    midiEventPacket_t read();
+    void sendMIDI(midiEventPacket_t packet) { sent.push_back(packet); }
+    void flush() {}
+};
+
+extern MIDI_ MidiUSB;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef Wire_h
+#define Wire_h
+
+class TwoWire
+{
+};
+
+extern TwoWire Wire1;
+
+#endif
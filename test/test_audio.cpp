@@ -0,0 +1,244 @@
+#include "audio.h"
+#include "check.h"
+#include <math.h>
+
+#define TICK_120_BPM 20833 // us
+
+// peak of one voice hit on its own, dry and send
+void hit(DrumVoices &drums, Sink &sink, int voice, int *dry_peak, int *send_peak)
+{
+  *dry_peak = 0;
+  *send_peak = 0;
+  drums.trigger(voice, 127);
+  do
+  {
+    sink.clear();
+    drums.update();
+    sink.update();
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+      *dry_peak = max(*dry_peak, abs(sink.samples[0][i]));
+      *send_peak = max(*send_peak, abs(sink.samples[1][i]));
+    }
+  } while (sink.has_block[0]);
+}
+
+void testVoices()
+{
+  DrumVoices drums;
+  Sink sink;
+  AudioConnection dry_cord(drums, 0, sink, 0);
+  AudioConnection send_cord(drums, 1, sink, 1);
+  drums.update();
+  sink.update();
+  CHECK(!sink.has_block[0]); // silence sends no blocks
+
+  for (int voice = 0; voice < DRUM_VOICES; voice++)
+  {
+    int dry_peak;
+    int send_peak;
+    hit(drums, sink, voice, &dry_peak, &send_peak);
+    CHECK(dry_peak > 1000);
+    CHECK(dry_peak < 32767); // no voice clips on its own
+  }
+
+  // the kick has no send until a controller gives it one
+  int dry_peak;
+  int send_peak;
+  hit(drums, sink, 0, &dry_peak, &send_peak);
+  CHECK_EQUAL(0, send_peak);
+  drums.set_send(0, 127);
+  hit(drums, sink, 0, &dry_peak, &send_peak);
+  CHECK(send_peak > dry_peak * 9 / 10);
+  drums.set_send(0, 64);
+  hit(drums, sink, 0, &dry_peak, &send_peak);
+  CHECK(abs(send_peak - dry_peak / 2) < dry_peak / 20);
+  drums.set_send(DRUM_VOICES, 127); // out of range, ignored
+  CHECK_EQUAL(0, AudioStream::blocks_in_use());
+}
+
+void testPacking()
+{
+  // every voice at once: the blocks are the synth's mixes in order,
+  // clipped to 16 bits rather than wrapped
+  DrumVoices drums;
+  Sink sink;
+  AudioConnection dry_cord(drums, 0, sink, 0);
+  AudioConnection send_cord(drums, 1, sink, 1);
+  DrumSynth reference;
+  for (int voice = 0; voice < DRUM_VOICES; voice++)
+  {
+    drums.set_send(voice, 127);
+    reference.set_send(voice, 127);
+    drums.trigger(voice, 127);
+    reference.trigger(voice, 127);
+  }
+  int32_t mixes[2][AUDIO_BLOCK_SAMPLES];
+  int clipped = 0;
+  int mismatches = 0;
+  for (int block = 0; block < 20; block++)
+  {
+    reference.render(mixes[0], mixes[1]);
+    sink.clear();
+    drums.update();
+    sink.update();
+    for (int output = 0; output < 2; output++)
+    {
+      for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+      {
+        int32_t expected = mixes[output][i] > 32767 ? 32767 : mixes[output][i] < -32768 ? -32768 : mixes[output][i];
+        clipped += expected != mixes[output][i];
+        mismatches += sink.samples[output][i] != expected;
+      }
+    }
+  }
+  CHECK(clipped > 0);
+  CHECK_EQUAL(0, mismatches);
+}
+
+// runs a master chain on silence but for a send input, returns the output
+struct Chain
+{
+  Source source;
+  MasterChain master;
+  Sink sink;
+  AudioConnection dry_cord;
+  AudioConnection send_cord;
+  AudioConnection out_cord;
+  Chain() : dry_cord(source, 0, master, 0), send_cord(source, 1, master, 1), out_cord(master, 0, sink, 0)
+  {
+    master.control(MASTER_FEEDBACK, 0);
+    master.control(MASTER_DELAY_MIX, 127);
+  }
+  std::vector<int16_t> process(int blocks, const int16_t *send_input = NULL, int input_length = 0, uint32_t (*clock)(int block) = NULL)
+  {
+    source.samples[1].assign(blocks * AUDIO_BLOCK_SAMPLES, 0);
+    for (int i = 0; i < input_length && i < (int)source.samples[1].size(); i++)
+    {
+      source.samples[1][i] = send_input[i];
+    }
+    source.position = 0;
+    sink.clear();
+    for (int block = 0; block < blocks; block++)
+    {
+      if (clock)
+      {
+        master.set_clock_period(clock(block));
+      }
+      source.update();
+      master.update();
+      sink.update();
+    }
+    return sink.samples[0];
+  }
+};
+
+uint32_t lengthAt(uint32_t tick_period)
+{
+  return (uint64_t)tick_period * 12 * (uint32_t)AUDIO_SAMPLE_RATE_EXACT / 1000000;
+}
+
+void testDelayLength()
+{
+  Chain chain;
+  int16_t impulse[1] = {20000};
+  std::vector<int16_t> output = chain.process(100, impulse, 1);
+  int first = -1;
+  for (size_t i = 0; i < output.size() && first < 0; i++)
+  {
+    if (output[i] != 0)
+    {
+      first = i;
+    }
+  }
+  CHECK(abs(first - (int)lengthAt(TICK_120_BPM)) <= 1);
+  CHECK(output[first] > 19000);
+
+  // jitter around the same tempo leaves the length alone
+  for (int i = 0; i < 200; i++)
+  {
+    chain.master.set_clock_period(TICK_120_BPM + (i % 7 - 3) * 100);
+  }
+  chain.process(10);
+  CHECK_EQUAL(first, chain.master.delay_length());
+
+  // a real change is glided to
+  uint32_t tick_140 = 60000000 / 140 / 24;
+  chain.master.set_clock_period(tick_140);
+  chain.process(1);
+  CHECK(chain.master.delay_length() < lengthAt(TICK_120_BPM));
+  CHECK(chain.master.delay_length() > lengthAt(tick_140));
+  chain.process(400);
+  CHECK_EQUAL(lengthAt(tick_140), chain.master.delay_length());
+
+  // an eighth no longer fits below about 81 BPM, a sixteenth and then a
+  // 32nd are used instead
+  uint32_t tick_82 = 60000000 / 82 / 24;
+  chain.master.set_clock_period(tick_82);
+  chain.process(1000);
+  CHECK_EQUAL(lengthAt(tick_82), chain.master.delay_length());
+  uint32_t tick_70 = 60000000 / 70 / 24;
+  chain.master.set_clock_period(tick_70);
+  chain.process(1000);
+  CHECK_EQUAL(lengthAt(tick_70) / 2, chain.master.delay_length());
+  uint32_t tick_30 = 60000000 / 30 / 24;
+  chain.master.set_clock_period(tick_30);
+  chain.process(1000);
+  CHECK_EQUAL(lengthAt(tick_30) / 4, chain.master.delay_length());
+  CHECK(chain.master.delay_length() < DELAY_POOL_SAMPLES);
+  CHECK_EQUAL(0, AudioStream::blocks_in_use());
+}
+
+uint32_t jitteredClock(int block)
+{
+  // the smoothed period still wanders by a few hundred us
+  return TICK_120_BPM + ((block * 7919) % 600) - 300;
+}
+
+uint32_t tempoChange(int block)
+{
+  return block < 200 ? TICK_120_BPM : 60000000 / 90 / 24;
+}
+
+int maxStep(const std::vector<int16_t> &output, size_t from, size_t to)
+{
+  int step = 0;
+  for (size_t i = from + 1; i < to; i++)
+  {
+    step = max(step, abs(output[i] - output[i - 1]));
+  }
+  return step;
+}
+
+void testNoClicks()
+{
+  // a steady tone through the delay, sample to sample steps of the output
+  // stay close to the tone's own while the clock jitters or the tempo moves
+  std::vector<int16_t> tone(AUDIO_BLOCK_SAMPLES * 1200);
+  for (size_t i = 0; i < tone.size(); i++)
+  {
+    tone[i] = 8000 * sinf(2 * M_PI * 200 * i / AUDIO_SAMPLE_RATE_EXACT);
+  }
+  int tone_step = maxStep(tone, 0, tone.size());
+  size_t settled = 100 * AUDIO_BLOCK_SAMPLES;
+
+  {
+    Chain chain;
+    std::vector<int16_t> output = chain.process(1200, &tone[0], tone.size(), jitteredClock);
+    CHECK(maxStep(output, settled, output.size()) <= tone_step * 11 / 10);
+  }
+
+  Chain chain;
+  std::vector<int16_t> output = chain.process(1200, &tone[0], tone.size(), tempoChange);
+  CHECK(maxStep(output, settled, output.size()) <= tone_step * 11 / 10);
+  CHECK_EQUAL(lengthAt(60000000 / 90 / 24), chain.master.delay_length());
+}
+
+int main()
+{
+  testVoices();
+  testPacking();
+  testDelayLength();
+  testNoClicks();
+  return check_report("audio");
+}
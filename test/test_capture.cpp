@@ -0,0 +1,145 @@
+// Records a capture through the serial commands, pulls it out with 'd' and
+// replays it on the same firmware, checking the outputs match and that the
+// live state is back where it was afterwards.
+#include "firmware.h"
+#include "check.h"
+
+#define CLOCK_PERIOD 20833 // us, 120 BPM
+
+void tap(int key, unsigned long hold_ms = 20)
+{
+  trellis.press(key, KEY_JUST_PRESSED);
+  runFor(hold_ms, CLOCK_PERIOD);
+  trellis.press(key, KEY_JUST_RELEASED);
+  runFor(20, CLOCK_PERIOD);
+}
+
+void combo(int key)
+{
+  trellis.press(7, KEY_JUST_PRESSED);
+  trellis.press(31, KEY_JUST_PRESSED);
+  runFor(20, CLOCK_PERIOD);
+  tap(key);
+  trellis.press(31, KEY_JUST_RELEASED);
+  trellis.press(7, KEY_JUST_RELEASED);
+  runFor(20, CLOCK_PERIOD);
+}
+
+void command(char c)
+{
+  Serial.input += c;
+  runFor(2, CLOCK_PERIOD);
+}
+
+int main()
+{
+  setup();
+  sendRealTime(0xFA);
+  runFor(200, CLOCK_PERIOD);
+
+  tap(0); // live edit in the main grid
+  combo(4); // shift mode
+  CHECK(!main_mode);
+
+  // start capturing with a key held down in shift mode
+  trellis.press(9, KEY_JUST_PRESSED);
+  runFor(30, CLOCK_PERIOD);
+  // the pattern storage goes to flash in the background, an edit behind
+  // the write position starts it over
+  command('c');
+  runFor(20, CLOCK_PERIOD);
+  CHECK(Serial.output.find("capturing") == std::string::npos);
+  grids[0][0][1].is_accented = true;
+  CHECK(runUntilOutput("capturing", 1000));
+  Note stored;
+  capture_region.read(FLASH_PAGE_SIZE + sizeof(Note), &stored, sizeof(Note));
+  CHECK(stored.is_accented);
+  runFor(300, CLOCK_PERIOD);
+  trellis.press(9, KEY_JUST_RELEASED); // toggles a shift grid note
+  runFor(100, CLOCK_PERIOD);
+  tap(18);
+  runFor(1000, CLOCK_PERIOD);
+  sendRealTime(0xFC);
+  runFor(100, CLOCK_PERIOD); // clocks while stopped are part of the capture
+  sendRealTime(0xFA);
+  runFor(500, CLOCK_PERIOD);
+  command('s');
+  CHECK(Serial.output.find("captured ") != std::string::npos);
+  CHECK(Serial.output.find("dropped 0") != std::string::npos);
+
+  Serial.output.clear();
+  command('d');
+  std::string dump = Serial.output;
+
+  // move the live state on: back to the main grid and one more edit
+  combo(12);
+  CHECK(main_mode);
+  tap(3);
+  runFor(50, CLOCK_PERIOD);
+  Note live[2][32][16];
+  memcpy(live, grids, sizeof(grids));
+  uint32_t live_tick = tick;
+
+  for (uint32_t offset = 0; offset < capture_region.size; offset += FLASH_SECTOR_SIZE)
+  {
+    capture_region.start_erase(offset);
+  }
+  CHECK(loadCapture(dump));
+
+  Serial.output.clear();
+  size_t sent = trellis.sent.size();
+  Serial.input += 'r';
+  CHECK(runUntilOutput("mean drift us: ", 10000));
+  runFor(1);
+  CHECK(Serial.output.find("replay matches") != std::string::npos);
+  CHECK(Serial.output.find("outputs: 0\n") == std::string::npos);
+  CHECK(trellis.sent.size() > sent + 10);
+
+  // live state is back, nothing stuck from the capture
+  CHECK(main_mode);
+  CHECK(!combo_pressed);
+  CHECK(!is_stopped);
+  CHECK_EQUAL(live_tick, tick);
+  for (int i = 0; i < 32; i++)
+  {
+    CHECK(!pressed_keys[i]);
+  }
+  CHECK(memcmp(live, grids, sizeof(grids)) == 0);
+
+  // undo walks back the live edits only: the last one, the two made while
+  // capturing and the first. The pads are redrawn while the combo is held.
+  sendRealTime(0xFC);
+  runFor(20);
+  trellis.press(7, KEY_JUST_PRESSED);
+  trellis.press(31, KEY_JUST_PRESSED);
+  runFor(20);
+  tap(1);
+  CHECK(trellis.pixels[0] != 0);
+  CHECK_EQUAL(0u, trellis.pixels[18]); // shift grid pad from the replay
+  trellis.press(31, KEY_JUST_RELEASED);
+  trellis.press(7, KEY_JUST_RELEASED);
+  runFor(20);
+  Note after_undo[2][32][16];
+  memcpy(after_undo, grids, sizeof(grids));
+  int changed = 0;
+  for (int i = 0; i < (int)(sizeof(grids) / sizeof(Note)); i++)
+  {
+    Note *a = &live[0][0][0] + i;
+    Note *b = &after_undo[0][0][0] + i;
+    changed += a->is_on != b->is_on || a->is_accented != b->is_accented;
+  }
+  CHECK_EQUAL(1, changed);
+  combo(1);
+  combo(1);
+  combo(1);
+  for (int i = 0; i < (int)(sizeof(grids) / sizeof(Note)); i++)
+  {
+    CHECK(!(&grids[0][0][0] + i)->is_on);
+  }
+
+  if (check_failures > 0)
+  {
+    fputs(Serial.output.c_str(), stdout);
+  }
+  return check_report("capture");
+}
@@ -0,0 +1,174 @@
+#include "History.h"
+#include "check.h"
+
+#define CELLS 64
+
+Note cells[CELLS];
+int row_offset;
+int last_step;
+int swing;
+History history;
+
+void reset()
+{
+  for (int i = 0; i < CELLS; i++)
+  {
+    cells[i] = Note();
+  }
+  row_offset = 12;
+  last_step = 8;
+  swing = 6;
+  history = History();
+  history.begin(cells, CELLS, &row_offset, &last_step, &swing);
+}
+
+void toggle(int index)
+{
+  uint8_t bits = History::bits(cells[index]);
+  cells[index].toggle();
+  history.record(cells[index], bits);
+}
+
+void setSwing(int value)
+{
+  history.record_param(PARAM_SWING, swing, value);
+  swing = value;
+}
+
+uint64_t pattern()
+{
+  uint64_t on = 0;
+  for (int i = 0; i < CELLS; i++)
+  {
+    on |= (uint64_t)cells[i].is_on << i;
+  }
+  return on;
+}
+
+void testUndoRedo()
+{
+  reset();
+  toggle(3);
+  toggle(5);
+  setSwing(8);
+  CHECK(history.undo());
+  CHECK_EQUAL(6, swing);
+  CHECK(history.undo());
+  CHECK_EQUAL(1 << 3, pattern());
+  CHECK(history.redo());
+  CHECK_EQUAL((1 << 3) | (1 << 5), pattern());
+  CHECK(history.undo());
+  CHECK(history.undo());
+  CHECK_EQUAL(0, pattern());
+  CHECK(!history.undo());
+}
+
+void testGroup()
+{
+  reset();
+  toggle(1);
+  history.begin_group();
+  for (int i = 0; i < CELLS; i++)
+  {
+    cells[i].off();
+  }
+  history.end_group();
+  CHECK_EQUAL(0, pattern());
+  CHECK(history.undo());
+  CHECK_EQUAL(1 << 1, pattern());
+}
+
+// the cells are borrowed by a replay and put back from a snapshot, the way
+// startReplay() and stopReplay() do with the session
+void replay(int edits, bool has_params = true)
+{
+  Note saved[CELLS];
+  int saved_swing = swing;
+  memcpy(saved, cells, sizeof(cells));
+  history.suspend();
+  for (int i = 0; i < edits; i++)
+  {
+    toggle((i * 7) % CELLS);
+    if (has_params && i % 5 == 0)
+    {
+      setSwing(6 + i % 4);
+    }
+  }
+  // undo inside the replay stays inside it
+  while (history.undo())
+  {
+  }
+  toggle(40);
+  memcpy(cells, saved, sizeof(cells));
+  swing = saved_swing;
+  history.resume();
+}
+
+void testUndoAfterReplay()
+{
+  reset();
+  toggle(3);
+  setSwing(9);
+  toggle(5);
+  uint64_t live = pattern();
+
+  replay(10);
+  CHECK_EQUAL(live, pattern());
+  CHECK(history.undo());
+  CHECK_EQUAL(1 << 3, pattern());
+  CHECK_EQUAL(9, swing);
+  CHECK(history.undo());
+  CHECK_EQUAL(6, swing);
+  CHECK(history.undo());
+  CHECK_EQUAL(0, pattern());
+  CHECK(!history.undo());
+
+  // redo entries survive too
+  CHECK(history.redo());
+  replay(3);
+  CHECK(history.redo());
+  CHECK(history.redo());
+  CHECK_EQUAL(live, pattern());
+  CHECK(!history.redo());
+}
+
+void testReplayWrappingTheJournal()
+{
+  reset();
+  for (int i = 0; i < 20; i++)
+  {
+    toggle(i);
+  }
+  uint64_t live = pattern();
+
+  // enough edits to wrap the ring, the oldest live entries are lost but
+  // whatever is left still undoes in order and never touches the replay's
+  replay(JOURNAL_SIZE - 12, false);
+  CHECK_EQUAL(live, pattern());
+  int undone = 0;
+  while (history.undo())
+  {
+    undone++;
+    CHECK_EQUAL(live & ~(~0ULL << (20 - undone)), pattern());
+  }
+  CHECK_EQUAL(12, undone);
+
+  reset();
+  toggle(1);
+  replay(JOURNAL_SIZE * 2);
+  CHECK_EQUAL(1 << 1, pattern());
+  CHECK(!history.undo()); // all of it was overwritten
+  CHECK_EQUAL(1 << 1, pattern());
+  toggle(2);
+  CHECK(history.undo());
+  CHECK_EQUAL(1 << 1, pattern());
+}
+
+int main()
+{
+  testUndoRedo();
+  testGroup();
+  testUndoAfterReplay();
+  testReplayWrappingTheJournal();
+  return check_report("history");
+}
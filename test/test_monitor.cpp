@@ -0,0 +1,123 @@
+#include "Monitor.h"
+#include "check.h"
+
+#define PERIOD 20833 // us between clocks at 120 BPM
+
+void clocks(Monitor &monitor, int count, unsigned long period)
+{
+  for (int i = 0; i < count; i++)
+  {
+    host_micros += period;
+    monitor.clock();
+  }
+}
+
+bool isNear(uint32_t period, uint32_t expected)
+{
+  return period > expected - expected / 64 && period < expected + expected / 64;
+}
+
+// the time since boot before the first clock is not a period
+void testFirstClockAfterIdle()
+{
+  Monitor monitor;
+  host_micros = 1500000;
+  monitor.clock();
+  clocks(monitor, 48, PERIOD);
+  CHECK(isNear(monitor.clock_period, PERIOD));
+  CHECK_EQUAL(0, monitor.merged_ticks);
+  CHECK_EQUAL(0, monitor.late_ticks);
+}
+
+// the seed is one interval, trusted after a quarter note on the period
+void testSteady()
+{
+  Monitor monitor;
+  monitor.clock();
+  clocks(monitor, 1, 20000);
+  CHECK(!monitor.is_clock_steady());
+  for (int i = 0; i < CLOCK_STEADY_TICKS - 1; i++)
+  {
+    clocks(monitor, 1, i % 2 ? 20000 : 21000); // clocks land on 1 ms USB frames
+  }
+  CHECK(!monitor.is_clock_steady());
+  clocks(monitor, 1, 21000);
+  CHECK(monitor.is_clock_steady());
+  CHECK(isNear(monitor.clock_period, 20500));
+
+  // measured again after a pause
+  clocks(monitor, 1, PERIOD * 5);
+  CHECK(!monitor.is_clock_steady());
+}
+
+// a stop and start keeps the period, the pause is not measured
+void testRestart()
+{
+  Monitor monitor;
+  clocks(monitor, 48, PERIOD);
+  host_micros += 2000000;
+  monitor.restart();
+  monitor.clock();
+  CHECK(isNear(monitor.clock_period, PERIOD));
+  clocks(monitor, 4, PERIOD);
+  CHECK(isNear(monitor.clock_period, PERIOD));
+  CHECK_EQUAL(0, monitor.late_ticks);
+}
+
+// a slow loop() pass is one late tick and the queued ones back to back
+void testSlowPass()
+{
+  Monitor monitor;
+  clocks(monitor, 48, PERIOD);
+  uint32_t period = monitor.clock_period;
+  clocks(monitor, 1, PERIOD * 3);
+  clocks(monitor, 2, 10);
+  clocks(monitor, 8, PERIOD);
+  CHECK_EQUAL(1, monitor.late_ticks);
+  CHECK_EQUAL(2, monitor.merged_ticks);
+  CHECK(isNear(monitor.clock_period, period));
+}
+
+// far faster or slower clocks are measured again after CLOCK_MISS_LIMIT
+void testTempoChange()
+{
+  Monitor monitor;
+  clocks(monitor, 48, PERIOD);
+  clocks(monitor, CLOCK_MISS_LIMIT + 8, PERIOD / 5);
+  CHECK_EQUAL(CLOCK_MISS_LIMIT, monitor.merged_ticks);
+  CHECK(isNear(monitor.clock_period, PERIOD / 5));
+
+  clocks(monitor, CLOCK_MISS_LIMIT + 8, PERIOD / 5 * 2);
+  CHECK_EQUAL(CLOCK_MISS_LIMIT, monitor.late_ticks);
+  CHECK(isNear(monitor.clock_period, PERIOD / 5 * 2));
+}
+
+void testOverruns()
+{
+  Monitor monitor;
+  monitor.loop_start();
+  host_micros += PERIOD * 2;
+  monitor.loop_end();
+  CHECK_EQUAL(0, monitor.overruns); // no period yet
+
+  clocks(monitor, 48, PERIOD);
+  monitor.loop_start();
+  host_micros += PERIOD / 2;
+  monitor.loop_end();
+  monitor.loop_start();
+  host_micros += PERIOD * 2;
+  monitor.loop_end();
+  CHECK_EQUAL(1, monitor.overruns);
+  CHECK_EQUAL(PERIOD * 2, monitor.max_loop_time);
+}
+
+int main()
+{
+  testFirstClockAfterIdle();
+  testSteady();
+  testRestart();
+  testSlowPass();
+  testTempoChange();
+  testOverruns();
+  return check_report("monitor");
+}
@@ -0,0 +1,262 @@
+#include "Repeater.h"
+#include "check.h"
+#include <vector>
+
+#define PERIOD 20833 // us between clocks at 120 BPM
+
+struct Played
+{
+  unsigned long time;
+  int pad;
+  int velocity;
+};
+
+Repeater repeater;
+std::vector<Played> played;
+unsigned long now;
+uint32_t tick;
+
+void reset(int rate, int order)
+{
+  repeater = Repeater();
+  repeater.rate = rate;
+  repeater.order = order;
+  played.clear();
+  now = 1000;
+  tick = 0;
+}
+
+void drain()
+{
+  uint8_t pad;
+  uint8_t velocity;
+  while (repeater.next_event(&pad, &velocity))
+  {
+    Played event = {now, pad, velocity};
+    played.push_back(event);
+  }
+}
+
+// clocks with update() polled every poll us in between, the way loop() does,
+// or never when poll is 0
+void run(int ticks, unsigned long poll)
+{
+  for (int i = 0; i < ticks; i++)
+  {
+    repeater.clock(tick++, now);
+    drain();
+    unsigned long next = now + PERIOD;
+    while (poll > 0 && now + poll < next)
+    {
+      now += poll;
+      repeater.update(now);
+      drain();
+    }
+    now = next;
+  }
+}
+
+std::vector<Played> notes()
+{
+  std::vector<Played> ons;
+  for (Played &event : played)
+  {
+    if (event.velocity > 0)
+    {
+      ons.push_back(event);
+    }
+  }
+  return ons;
+}
+
+void testRateSpacing()
+{
+  int rates[] = {24, 16, 12, 8, 6, 4, 3, 2};
+  for (int rate : rates)
+  {
+    reset(rate, REPEAT_ALL);
+    repeater.hold(0);
+    run(96, 100);
+    std::vector<Played> ons = notes();
+    CHECK_EQUAL(96 * 2 / rate, ons.size());
+    for (size_t i = 1; i < ons.size(); i++)
+    {
+      long spacing = ons[i].time - ons[i - 1].time;
+      CHECK(labs(spacing - (long)rate * PERIOD / 2) <= 100);
+    }
+    // every note is closed before the next one
+    CHECK_EQUAL(2 * ons.size(), played.size());
+    for (size_t i = 0; i + 1 < played.size(); i += 2)
+    {
+      CHECK(played[i].velocity > 0 && played[i + 1].velocity == 0);
+    }
+    CHECK_EQUAL(0, repeater.dropped);
+  }
+}
+
+void testOddHalfTickWithoutUpdate()
+{
+  // a pass through loop() longer than half a clock never calls update()
+  // between two clocks, the 1/64 note on the odd half tick still plays
+  reset(3, REPEAT_ALL);
+  repeater.hold(4);
+  run(48, 0);
+  CHECK_EQUAL(32, notes().size());
+  CHECK_EQUAL(0, repeater.dropped);
+
+  // a relocation does not make up half ticks that were skipped
+  reset(3, REPEAT_ALL);
+  repeater.hold(4);
+  run(2, 100);
+  size_t count = notes().size();
+  tick = 40;
+  repeater.clock(tick++, now);
+  drain();
+  CHECK_EQUAL(count, notes().size());
+}
+
+void testStopAfterClock()
+{
+  // a stop right after a clock clears the repeater, update() must not play
+  // the odd half tick of the old position with nothing left to close it
+  reset(3, REPEAT_ALL);
+  repeater.hold(4);
+  run(1, 100);
+  repeater.clock(tick++, now);
+  drain();
+  repeater.clear();
+  for (int i = 0; i < 10; i++)
+  {
+    now += PERIOD / 10;
+    repeater.update(now);
+    drain();
+  }
+  CHECK_EQUAL(1, notes().size());
+  CHECK_EQUAL(2, played.size());
+}
+
+void testOrder()
+{
+  int up[] = {2, 5, 9, 2, 5, 9, 2};
+  reset(6, REPEAT_UP);
+  repeater.hold(9);
+  repeater.hold(2);
+  repeater.hold(5);
+  run(21, 100);
+  std::vector<Played> ons = notes();
+  CHECK_EQUAL(7, ons.size());
+  for (int i = 0; i < 7; i++)
+  {
+    CHECK_EQUAL(up[i], ons[i].pad);
+  }
+
+  int down[] = {9, 5, 2, 9, 5, 2, 9};
+  reset(6, REPEAT_DOWN);
+  repeater.hold(2);
+  repeater.hold(5);
+  repeater.hold(9);
+  run(21, 100);
+  ons = notes();
+  CHECK_EQUAL(7, ons.size());
+  for (int i = 0; i < 7; i++)
+  {
+    CHECK_EQUAL(down[i], ons[i].pad);
+  }
+
+  // a pad held mid run joins in order
+  reset(6, REPEAT_UP);
+  repeater.hold(1);
+  repeater.hold(8);
+  run(6, 100);
+  repeater.hold(4);
+  run(12, 100);
+  ons = notes();
+  int joined[] = {1, 8, 1, 4, 8, 1};
+  CHECK_EQUAL(6, ons.size());
+  for (int i = 0; i < 6; i++)
+  {
+    CHECK_EQUAL(joined[i], ons[i].pad);
+  }
+
+  reset(2, REPEAT_RANDOM);
+  repeater.hold(0);
+  repeater.hold(7);
+  repeater.hold(15);
+  run(300, 100);
+  ons = notes();
+  int counts[REPEAT_PADS] = {0};
+  int repeats = 0;
+  for (size_t i = 0; i < ons.size(); i++)
+  {
+    counts[ons[i].pad]++;
+    repeats += i > 0 && ons[i].pad == ons[i - 1].pad;
+  }
+  CHECK_EQUAL(300, ons.size());
+  CHECK_EQUAL(300, counts[0] + counts[7] + counts[15]);
+  for (int pad : {0, 7, 15})
+  {
+    CHECK(counts[pad] > 70 && counts[pad] < 130);
+  }
+  CHECK(repeats > 60 && repeats < 140); // not a fixed cycle
+
+  reset(12, REPEAT_ALL);
+  repeater.hold(3);
+  repeater.hold(6);
+  run(12, 100);
+  ons = notes();
+  CHECK_EQUAL(4, ons.size());
+  CHECK_EQUAL(ons[0].time, ons[1].time);
+  CHECK_EQUAL(3, ons[0].pad);
+  CHECK_EQUAL(6, ons[1].pad);
+}
+
+void testQueueOverflow()
+{
+  // nothing drains the queue, a step only goes in whole
+  reset(2, REPEAT_ALL);
+  for (int pad = 0; pad < 10; pad++)
+  {
+    repeater.hold(pad);
+  }
+  repeater.clock(0, now);
+  CHECK_EQUAL(0, repeater.dropped);
+  repeater.clock(1, now + PERIOD);
+  CHECK_EQUAL(10, repeater.dropped);
+  drain();
+  CHECK_EQUAL(20, played.size());
+
+  // all 16 pads at the fastest rate: the note-offs still queued when the
+  // next step comes leave no room for it, every other step is dropped and
+  // counted, nothing is left hanging
+  reset(2, REPEAT_ALL);
+  for (int pad = 0; pad < REPEAT_PADS; pad++)
+  {
+    repeater.hold(pad);
+  }
+  run(24, 100);
+  std::vector<Played> ons = notes();
+  CHECK(repeater.dropped > 0);
+  CHECK_EQUAL(24 * REPEAT_PADS, ons.size() + repeater.dropped);
+  repeater.release_all();
+  run(2, 100);
+  CHECK_EQUAL(2 * ons.size(), played.size());
+
+  // clear() drops what is queued without counting it
+  reset(2, REPEAT_ALL);
+  repeater.hold(0);
+  repeater.clock(0, now);
+  repeater.clear();
+  drain();
+  CHECK_EQUAL(0, played.size());
+  CHECK_EQUAL(0, repeater.dropped);
+}
+
+int main()
+{
+  testRateSpacing();
+  testOddHalfTickWithoutUpdate();
+  testStopAfterClock();
+  testOrder();
+  testQueueOverflow();
+  return check_report("repeater");
+}
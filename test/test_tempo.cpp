@@ -0,0 +1,41 @@
+// Follows the MIDI clock through loop(): the monitor's period estimate and
+// the master delay length that is set from it.
+#include "firmware.h"
+#include "check.h"
+
+#define TICK_120_BPM 20833 // us
+#define TICK_100_BPM 25000
+#define DELAY_120_BPM 11025 // samples in an eighth note
+
+int main()
+{
+  setup();
+  runFor(1500); // idle before the first clock
+  sendRealTime(0xFA);
+  runFor(5000, TICK_120_BPM);
+  CHECK(abs((int)master.delay_length() - DELAY_120_BPM) <= 1);
+  CHECK(abs((int)monitor.clock_period - TICK_120_BPM) < 300);
+  CHECK_EQUAL(0, monitor.merged_ticks);
+  CHECK_EQUAL(0, monitor.late_ticks);
+
+  // a long stop is not a period either
+  sendRealTime(0xFC);
+  runFor(3000);
+  sendRealTime(0xFB);
+  runFor(2000, TICK_120_BPM);
+  CHECK(abs((int)master.delay_length() - DELAY_120_BPM) <= 1);
+  CHECK_EQUAL(0, monitor.late_ticks);
+
+  // a new tempo is followed to within the delay's jitter tolerance
+  runFor(5000, TICK_100_BPM);
+  CHECK(abs((int)monitor.clock_period - TICK_100_BPM) < 300);
+  uint32_t length = (uint64_t)TICK_100_BPM * 12 * (uint32_t)AUDIO_SAMPLE_RATE_EXACT / 1000000;
+  CHECK(abs((int)master.delay_length() - (int)length) <= (int)length / DELAY_TOLERANCE);
+  CHECK_EQUAL(0, monitor.merged_ticks);
+
+  if (check_failures > 0)
+  {
+    fputs(Serial.output.c_str(), stdout);
+  }
+  return check_report("tempo");
+}
@@ -0,0 +1,192 @@
+#include "Transport.h"
+#include "check.h"
+
+uint32_t tick;
+boolean is_stopped;
+boolean is_upbeat;
+int swing;
+int notes_off_calls;
+uint32_t tick_at_notes_off;
+
+Transport transport;
+
+void notesOff()
+{
+  notes_off_calls++;
+  tick_at_notes_off = tick;
+}
+
+midiEventPacket_t packet(uint8_t header, uint8_t byte1, uint8_t byte2 = 0, uint8_t byte3 = 0)
+{
+  midiEventPacket_t packet = {header, byte1, byte2, byte3};
+  return packet;
+}
+
+midiEventPacket_t songPosition(uint16_t sixteenth_note)
+{
+  return packet(3, 0xF2, sixteenth_note & 0x7F, sixteenth_note >> 7);
+}
+
+// advances tick the way the clock branch in main.cpp does
+void sendClock()
+{
+  if (transport.handle(packet(15, 0xF8)) != TRANSPORT_CLOCK)
+  {
+    return;
+  }
+  if ((int)(tick % 12) == swing - (swing / 2))
+  {
+    is_upbeat = true;
+  }
+  else if ((int)(tick % 12) == swing + ((12 - swing) / 2))
+  {
+    is_upbeat = false;
+  }
+  tick++;
+}
+
+void reset()
+{
+  tick = 0;
+  is_stopped = true;
+  is_upbeat = false;
+  swing = 6;
+  notes_off_calls = 0;
+  tick_at_notes_off = 0;
+  Serial.output.clear();
+  transport.begin(&tick, &is_stopped, &is_upbeat, &swing, notesOff);
+}
+
+void testSongPositionDecoding()
+{
+  CHECK_EQUAL(0, songPositionToSixteenthNote(0, 0));
+  CHECK_EQUAL(5, songPositionToSixteenthNote(5, 0));
+  CHECK_EQUAL(128, songPositionToSixteenthNote(0, 1));
+  CHECK_EQUAL(0x3FFF, songPositionToSixteenthNote(0x7F, 0x7F));
+  CHECK_EQUAL(0x1FAB, songPositionToSixteenthNote(0x2B, 0x3F));
+  CHECK_EQUAL(5, songPositionToSixteenthNote(0x85, 0x80)); // status bits ignored
+  CHECK_EQUAL(6 * 0x3FFF, sixteenthNoteToTicks(0x3FFF));
+}
+
+void testSongPositionUsesBothBytes()
+{
+  reset();
+  CHECK_EQUAL(TRANSPORT_POSITION, transport.handle(songPosition(300))); // LSB 44, MSB 2
+  CHECK_EQUAL(1800, tick);
+  CHECK_EQUAL(1, notes_off_calls);
+  CHECK(is_stopped); // position alone does not start playback
+
+  CHECK_EQUAL(TRANSPORT_POSITION, transport.handle(songPosition(7)));
+  CHECK_EQUAL(42, tick);
+  CHECK_EQUAL(2, notes_off_calls);
+}
+
+void testUpbeatPhaseMatchesPlayingThrough()
+{
+  for (swing = 6; swing <= 9; swing++)
+  {
+    int test_swing = swing;
+    for (uint32_t target = 0; target < 48; target++)
+    {
+      reset();
+      swing = test_swing;
+      is_stopped = false;
+      while (tick < target)
+      {
+        sendClock();
+      }
+      boolean played_upbeat = is_upbeat;
+      CHECK_EQUAL(played_upbeat, isUpbeatAfter(target, swing));
+    }
+    swing = test_swing;
+  }
+}
+
+void testStart()
+{
+  reset();
+  transport.handle(songPosition(16));
+  is_upbeat = true;
+  CHECK_EQUAL(TRANSPORT_START, transport.handle(packet(15, 0xFA)));
+  CHECK_EQUAL(0, tick);
+  CHECK(!is_stopped);
+  CHECK(!is_upbeat);
+  CHECK_EQUAL(2, notes_off_calls);
+  sendClock();
+  sendClock();
+  CHECK_EQUAL(2, tick);
+}
+
+void testContinueAfterSongPosition()
+{
+  reset();
+  transport.handle(packet(15, 0xFA));
+  for (int i = 0; i < 30; i++)
+  {
+    sendClock();
+  }
+  transport.handle(packet(15, 0xFC));
+  CHECK(is_stopped);
+
+  transport.handle(songPosition(9)); // 54 ticks, halfway through an eighth
+  CHECK_EQUAL(54, tick);
+  CHECK_EQUAL(isUpbeatAfter(54, swing), is_upbeat);
+
+  CHECK_EQUAL(TRANSPORT_CONTINUE, transport.handle(packet(15, 0xFB)));
+  CHECK(!is_stopped);
+  CHECK_EQUAL(54, tick); // continue keeps the position
+  sendClock();
+  CHECK_EQUAL(55, tick);
+}
+
+void testStopThenNoteOffs()
+{
+  reset();
+  transport.handle(packet(15, 0xFA));
+  for (int i = 0; i < 13; i++)
+  {
+    sendClock();
+  }
+  int calls = notes_off_calls;
+  CHECK_EQUAL(TRANSPORT_STOP, transport.handle(packet(15, 0xFC)));
+  CHECK(is_stopped);
+  CHECK_EQUAL(calls + 1, notes_off_calls);
+  CHECK_EQUAL(13, tick_at_notes_off);
+
+  // clocks keep coming while stopped, they are swallowed and tick holds
+  for (int i = 0; i < 24; i++)
+  {
+    CHECK_EQUAL(TRANSPORT_IGNORED, transport.handle(packet(15, 0xF8)));
+  }
+  CHECK_EQUAL(13, tick);
+}
+
+void testOtherRealTimeBytesAreConsumed()
+{
+  reset();
+  is_stopped = false;
+  uint8_t bytes[] = {0xF9, 0xFD, 0xFE, 0xFF};
+  for (uint8_t byte1 : bytes)
+  {
+    CHECK_EQUAL(TRANSPORT_IGNORED, transport.handle(packet(15, byte1)));
+  }
+  CHECK_EQUAL(0, tick);
+  CHECK_EQUAL(0, notes_off_calls);
+  CHECK(Serial.output.empty());
+
+  CHECK_EQUAL(TRANSPORT_NONE, transport.handle(packet(11, 0xB0, 10, 64)));
+  CHECK_EQUAL(TRANSPORT_NONE, transport.handle(packet(9, 0x90, 36, 100)));
+  CHECK_EQUAL(TRANSPORT_NONE, transport.handle(packet(0, 0, 0, 0)));
+}
+
+int main()
+{
+  testSongPositionDecoding();
+  testSongPositionUsesBothBytes();
+  testUpbeatPhaseMatchesPlayingThrough();
+  testStart();
+  testContinueAfterSongPosition();
+  testStopThenNoteOffs();
+  testOtherRealTimeBytesAreConsumed();
+  return check_report("transport");
+}